@@ -0,0 +1,127 @@
+#pragma once
+
+#include <utility>
+#include <optional>
+#include "CoroDetail.h"
+#include "FramePool.h"
+#include "Cancellation.h"
+
+namespace Coro::AsyncGenerator::Internal {
+    using namespace Coro::Internal;
+
+    // hands the control back to the consumer that is waiting for the next value, or for the end of the sequence
+    struct ConsumerTransfer {
+        AwaitCore *Consumer;
+        // the producer to re-enter when it is resumed after a yield
+        CancellationAware *Producer{nullptr};
+
+        [[nodiscard]] constexpr bool await_ready() const noexcept { return false; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<>) noexcept { return Consumer->Transfer(); }
+
+        void await_resume() const noexcept { if (Producer) Producer->Enter(); }
+    };
+
+    template<class T>
+    class Promise : public PooledFrame, public CancellationAware {
+    public:
+        auto initial_suspend() noexcept { return StartLazily(); }
+
+        auto final_suspend() noexcept {
+            Leave();
+            mDone = true;
+            return ConsumerTransfer{mConsumer};
+        }
+
+        template<class U = T>
+        auto yield_value(U &&value) {
+            // the yield suspends without going through await_transform
+            Leave();
+            mValue.emplace(std::forward<U>(value));
+            return ConsumerTransfer{mConsumer, this};
+        }
+
+        void return_void() noexcept {}
+
+        void unhandled_exception() noexcept { mFail = std::current_exception(); }
+
+        void SetConsumer(AwaitCore *consumer) noexcept { mConsumer = consumer; }
+
+        std::optional<T> Take() {
+            if (mFail) std::rethrow_exception(std::exchange(mFail, nullptr));
+            if (mDone) return std::nullopt;
+            auto result = std::move(mValue);
+            mValue.reset();
+            return result;
+        }
+
+        [[nodiscard]] bool IsDone() const noexcept { return mDone; }
+
+    private:
+        bool mDone{false};
+        AwaitCore *mConsumer{nullptr};
+        std::exception_ptr mFail{nullptr};
+        std::optional<T> mValue{std::nullopt};
+    };
+}
+
+// A lazily started producer of a sequence of values, pulled one at a time by a single consumer with
+//     while (auto value = co_await generator.Next()) { ... }
+// The producer runs in place on the consumer's thread until it yields, and is suspended until the next value is
+// pulled, so it never runs ahead of the consumer. The producer may await in between, in which case the consumer is
+// resumed on its own executor when the value is yielded
+template<class T>
+class AsyncGenerator {
+public:
+    struct promise_type : Coro::AsyncGenerator::Internal::Promise<T> {
+        AsyncGenerator get_return_object() {
+            return AsyncGenerator(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+    class Await : Coro::Internal::AwaitCore {
+    public:
+        explicit Await(Handle h) noexcept: mHandle(h) {}
+
+        [[nodiscard]] bool await_ready() const noexcept { return mHandle.promise().IsDone(); }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) noexcept {
+            SetHandle(h);
+            mHandle.promise().SetConsumer(this);
+            return mHandle;
+        }
+
+        std::optional<T> await_resume() { return mHandle.promise().Take(); }
+
+    private:
+        Handle mHandle;
+    };
+
+    constexpr AsyncGenerator() noexcept = default;
+
+    AsyncGenerator(AsyncGenerator &&other) noexcept: mHandle(std::exchange(other.mHandle, nullptr)) {}
+
+    AsyncGenerator(const AsyncGenerator &other) = delete;
+
+    AsyncGenerator &operator=(AsyncGenerator &&other) noexcept {
+        this->~AsyncGenerator();
+        mHandle = std::exchange(other.mHandle, nullptr);
+        return *this;
+    }
+
+    AsyncGenerator &operator=(const AsyncGenerator &other) = delete;
+
+    // the producer should be suspended, either not started, at a yield or finished
+    ~AsyncGenerator() noexcept { if (mHandle) mHandle.destroy(); }
+
+    // resumes the producer for the next value, an empty optional marks the end of the sequence.
+    // a failure of the producer is rethrown once, after which the sequence is ended
+    Await Next() noexcept { return Await(mHandle); }
+
+private:
+    Handle mHandle{nullptr};
+
+    explicit AsyncGenerator(Handle handle) noexcept: mHandle(handle) {}
+};
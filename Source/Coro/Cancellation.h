@@ -0,0 +1,338 @@
+#pragma once
+
+#include <bit>
+#include <mutex>
+#include <atomic>
+#include <utility>
+#include <coroutine>
+#include <exception>
+#include <Temp/Temp.h>
+#include <Conc/SpinLock.h>
+
+namespace Coro::Internal {
+    class CancellationState;
+
+    // intrusive node of a callback that is invoked once the owning source is cancelled.
+    // the node is owned by the registering party and should be deregistered before it is destroyed.
+    // the callback may be invoked on any thread and should not block nor resume anything inline
+    class CancellationCallback {
+    public:
+        using Fn = void (*)(CancellationCallback *) noexcept;
+
+        explicit CancellationCallback(Fn fn) noexcept: mFn(fn) {}
+
+        CancellationCallback(CancellationCallback &&) = delete;
+
+        CancellationCallback(const CancellationCallback &) = delete;
+
+        CancellationCallback &operator=(CancellationCallback &&) = delete;
+
+        CancellationCallback &operator=(const CancellationCallback &) = delete;
+
+    private:
+        friend class CancellationState;
+
+        Fn mFn;
+        bool mLinked{false};
+        std::atomic_bool mDone{false};
+        CancellationCallback *mPrev{nullptr}, *mNext{nullptr};
+    };
+
+    class CancellationState {
+    public:
+        [[nodiscard]] bool IsCancelled() const noexcept { return mCancelled.load(std::memory_order_acquire); }
+
+        // if the state is already cancelled, the callback is invoked in place
+        void Register(CancellationCallback *cb) noexcept {
+            {
+                std::lock_guard lk{mLock};
+                if (!mCancelled) {
+                    cb->mLinked = true;
+                    cb->mNext = mHead;
+                    if (mHead) mHead->mPrev = cb;
+                    mHead = cb;
+                    return;
+                }
+            }
+            Invoke(cb);
+        }
+
+        void Deregister(CancellationCallback *cb) noexcept {
+            {
+                std::lock_guard lk{mLock};
+                if (cb->mLinked) return Unlink(cb);
+            }
+            // the callback has been taken by Cancel(), wait for its invocation to finish
+            SpinWait spinner{};
+            while (!cb->mDone.load(std::memory_order_acquire)) spinner.SpinOnce();
+        }
+
+        bool Cancel() noexcept {
+            std::unique_lock lk{mLock};
+            if (mCancelled) return false;
+            mCancelled.store(true, std::memory_order_release);
+            while (mHead) {
+                const auto cb = mHead;
+                Unlink(cb);
+                // the lock is released during the invocation so that the callback could deregister other nodes
+                lk.unlock();
+                Invoke(cb);
+                lk.lock();
+            }
+            return true;
+        }
+
+        void Acquire() noexcept { mRef.fetch_add(1, std::memory_order_relaxed); }
+
+        void Release() noexcept {
+            if (mRef.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                auto alloc = temp_alloc<CancellationState>{};
+                allocator_destruct(alloc, this);
+            }
+        }
+
+        static CancellationState *Create() {
+            auto alloc = temp_alloc<CancellationState>{};
+            return allocator_construct<CancellationState>(alloc);
+        }
+
+    private:
+        std::atomic_int mRef{1};
+        std::atomic_bool mCancelled{false};
+        Lock<SpinLock> mLock{};
+        CancellationCallback *mHead{nullptr};
+
+        void Unlink(CancellationCallback *cb) noexcept {
+            if (cb->mPrev) cb->mPrev->mNext = cb->mNext; else mHead = cb->mNext;
+            if (cb->mNext) cb->mNext->mPrev = cb->mPrev;
+            cb->mPrev = cb->mNext = nullptr;
+            cb->mLinked = false;
+        }
+
+        static void Invoke(CancellationCallback *cb) noexcept {
+            cb->mFn(cb);
+            cb->mDone.store(true, std::memory_order_release);
+        }
+    };
+
+    // the token of the coroutine running on this thread, borrowed from its promise or from a CancellationScope
+    inline thread_local CancellationState *tAmbient{nullptr};
+}
+
+class OperationCancelled : public std::exception {
+public:
+    [[nodiscard]] const char *what() const noexcept override { return "operation cancelled"; }
+};
+
+class CancellationToken {
+    using State = Coro::Internal::CancellationState;
+public:
+    using Callback = Coro::Internal::CancellationCallback;
+
+    constexpr CancellationToken() noexcept = default;
+
+    CancellationToken(const CancellationToken &other) noexcept: mState(other.mState) { if (mState) mState->Acquire(); }
+
+    CancellationToken(CancellationToken &&other) noexcept: mState(std::exchange(other.mState, nullptr)) {}
+
+    CancellationToken &operator=(const CancellationToken &other) noexcept {
+        if (this != &other) {
+            this->~CancellationToken();
+            if ((mState = other.mState)) mState->Acquire();
+        }
+        return *this;
+    }
+
+    CancellationToken &operator=(CancellationToken &&other) noexcept {
+        if (this != &other) {
+            this->~CancellationToken();
+            mState = std::exchange(other.mState, nullptr);
+        }
+        return *this;
+    }
+
+    ~CancellationToken() noexcept { if (mState) mState->Release(); }
+
+    [[nodiscard]] bool CanBeCancelled() const noexcept { return mState; }
+
+    [[nodiscard]] bool IsCancelled() const noexcept { return mState && mState->IsCancelled(); }
+
+    void Register(Callback *cb) const noexcept { if (mState) mState->Register(cb); }
+
+    void Deregister(Callback *cb) const noexcept { if (mState) mState->Deregister(cb); }
+
+    explicit operator bool() const noexcept { return mState; }
+
+    void ThrowIfCancelled() const { if (IsCancelled()) throw OperationCancelled(); }
+
+    // the token of the running coroutine, inherited from the context it was created in
+    [[nodiscard]] static CancellationToken Current() noexcept {
+        const auto state = Coro::Internal::tAmbient;
+        return state ? CancellationToken(state) : CancellationToken();
+    }
+
+    // the cheap check at a checkpoint of the running coroutine, without taking a reference to the token
+    [[nodiscard]] static bool IsCurrentCancelled() noexcept {
+        const auto state = Coro::Internal::tAmbient;
+        return state && state->IsCancelled();
+    }
+
+private:
+    friend class CancellationSource;
+    friend class CancellationScope;
+
+    State *mState{nullptr};
+
+    explicit CancellationToken(State *state) noexcept: mState(state) { mState->Acquire(); }
+};
+
+class CancellationSource {
+    using State = Coro::Internal::CancellationState;
+public:
+    CancellationSource() : mState(State::Create()) {}
+
+    CancellationSource(CancellationSource &&other) noexcept: mState(std::exchange(other.mState, nullptr)) {}
+
+    CancellationSource(const CancellationSource &) = delete;
+
+    CancellationSource &operator=(CancellationSource &&other) noexcept {
+        if (this != &other) {
+            this->~CancellationSource();
+            mState = std::exchange(other.mState, nullptr);
+        }
+        return *this;
+    }
+
+    CancellationSource &operator=(const CancellationSource &) = delete;
+
+    ~CancellationSource() noexcept { if (mState) mState->Release(); }
+
+    [[nodiscard]] CancellationToken Token() const noexcept { return CancellationToken(mState); }
+
+    [[nodiscard]] bool IsCancelled() const noexcept { return mState->IsCancelled(); }
+
+    // returns false if the source has already been cancelled
+    bool Cancel() noexcept { return mState->Cancel(); }
+
+private:
+    State *mState;
+};
+
+// Sets the token inherited by the coroutines created within the scope, and by the IO operations submitted within it
+// that do not carry a token of their own. An empty token detaches the work created within the scope from the current
+// token. The scope should not span a co_await, the running coroutine restores its own token when it is resumed
+class CancellationScope {
+public:
+    explicit CancellationScope(CancellationToken token) noexcept:
+            mToken(std::move(token)), mOuter(std::exchange(Coro::Internal::tAmbient, mToken.mState)) {}
+
+    CancellationScope(const CancellationScope &) = delete;
+
+    CancellationScope &operator=(const CancellationScope &) = delete;
+
+    ~CancellationScope() noexcept { Coro::Internal::tAmbient = mOuter; }
+
+private:
+    CancellationToken mToken;
+    Coro::Internal::CancellationState *mOuter;
+};
+
+namespace Coro::Internal {
+    template<class A>
+    decltype(auto) GetAwaiter(A &&awaitable) {
+        if constexpr (requires { std::forward<A>(awaitable).operator co_await(); }) {
+            return std::forward<A>(awaitable).operator co_await();
+        }
+        else if constexpr (requires { operator co_await(std::forward<A>(awaitable)); }) {
+            return operator co_await(std::forward<A>(awaitable));
+        }
+        else return std::forward<A>(awaitable);
+    }
+
+    // Mixed into promise types so that the coroutine inherits the token of the context it is created in, and makes
+    // it the ambient token of the thread while its body runs. The ambient token is only swapped on resumption when
+    // there is a token on either side, and only restored on suspension when it has been swapped, so a coroutine
+    // that never meets a token pays a thread-local read per resumption and writes nothing. The token is not checked
+    // at every co_await, a cancelled coroutine still has to be able to await its cleanup such as closing a file, it
+    // is observed where work is started instead, by the IO operations and the explicit ThrowIfCancelled checkpoints
+    class CancellationAware {
+        // the token is only restored when the coroutine has left it, an await that is ready already does not
+        // suspend and leaves the ambient token untouched
+        template<class Awaiter>
+        struct AmbientAwait {
+            CancellationAware *Scope;
+            Awaiter Inner;
+            bool Suspended{false};
+
+            [[nodiscard]] bool await_ready() { return Inner.await_ready(); }
+
+            template<class Promise>
+            decltype(auto) await_suspend(std::coroutine_handle<Promise> h) {
+                Scope->Leave();
+                Suspended = true;
+                try { return Inner.await_suspend(h); }
+                catch (...) {
+                    // resumed in place with the exception, which skips the await_resume
+                    Scope->Enter();
+                    throw;
+                }
+            }
+
+            decltype(auto) await_resume() {
+                if (Suspended) Scope->Enter();
+                return Inner.await_resume();
+            }
+        };
+
+        struct EagerStart {
+            CancellationAware *Scope;
+
+            [[nodiscard]] constexpr bool await_ready() const noexcept { return true; }
+
+            constexpr void await_suspend(std::coroutine_handle<>) const noexcept {}
+
+            void await_resume() const noexcept { Scope->Enter(); }
+        };
+
+        struct LazyStart {
+            CancellationAware *Scope;
+
+            [[nodiscard]] constexpr bool await_ready() const noexcept { return false; }
+
+            constexpr void await_suspend(std::coroutine_handle<>) const noexcept {}
+
+            void await_resume() const noexcept { Scope->Enter(); }
+        };
+    public:
+        CancellationAware() noexcept: mState(tAmbient) { if (mState) mState->Acquire(); }
+
+        CancellationAware(const CancellationAware &) = delete;
+
+        CancellationAware &operator=(const CancellationAware &) = delete;
+
+        ~CancellationAware() noexcept { if (mState) mState->Release(); }
+
+        template<class A>
+        auto await_transform(A &&awaitable) {
+            using Awaiter = decltype(GetAwaiter(std::forward<A>(awaitable)));
+            return AmbientAwait<Awaiter>{this, GetAwaiter(std::forward<A>(awaitable))};
+        }
+
+        EagerStart StartEagerly() noexcept { return {this}; }
+
+        LazyStart StartLazily() noexcept { return {this}; }
+
+        void Enter() noexcept {
+            if (mState || tAmbient) mOuter = std::exchange(tAmbient, mState); else mOuter = UNTOUCHED;
+        }
+
+        // should be called before the coroutine suspends, which includes the final suspension
+        void Leave() noexcept { if (mOuter != UNTOUCHED) tAmbient = mOuter; }
+
+    private:
+        // marks that the ambient token has been left as it was on the last resumption
+        inline static CancellationState *UNTOUCHED = std::bit_cast<CancellationState *>(~uintptr_t(0));
+
+        CancellationState *mState, *mOuter{UNTOUCHED};
+    };
+}
@@ -1,7 +1,11 @@
 #pragma once
 
 #include "FlexAsync.h"
+#include "AsyncGenerator.h"
+#include "Sync.h"
 #include "ValueAsync.h"
+#include "LazyAsync.h"
+#include "When.h"
 
 class SwitchTo {
 public:
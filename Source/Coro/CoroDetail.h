@@ -51,16 +51,12 @@ namespace Coro::Internal {
         template<class ...U>
         explicit ContinuableValueMedia(U &&... v): ContControl(std::forward<U>(v)...) {}
 
+        // stores the result without dispatching the continuation, which is left to the derived media as the
+        // controls differ in how they hand the continuations over
         template<class ...U>
-        void Set(U &&... v) {
-            mValueStore.Set(std::forward<U>(v)...);
-            ContControl::DispatchContinuation();
-        }
+        void Store(U &&... v) { mValueStore.Set(std::forward<U>(v)...); }
 
-        void Fail() {
-            mValueStore.Fail(std::current_exception());
-            ContControl::DispatchContinuation();
-        }
+        void StoreFailure() { mValueStore.Fail(std::current_exception()); }
 
         T Get() { return mValueStore.Get(); }
 
@@ -71,10 +67,17 @@ namespace Coro::Internal {
 
     class AwaitCore: public Object {
     public:
+        // a continuation that decides by itself how it is resumed, such as a node of a combinator or an awaiter with a
+        // resume policy. it is notified in place on the completing thread, and returns the handle to transfer to or
+        // noop_coroutine()
+        using Notify = std::coroutine_handle<> (*)(AwaitCore *) noexcept;
+
         AwaitCore() noexcept: mExec(CurrentExecutor()) {}
 
         explicit AwaitCore(IExecutor *next) noexcept: mExec(next) {}
 
+        explicit AwaitCore(Notify notify) noexcept: mExec(nullptr), mNotify(notify) {}
+
         // Await-related classes are not supposed to be copied nor moved
         AwaitCore(AwaitCore &&) = delete;
 
@@ -87,11 +90,28 @@ namespace Coro::Internal {
         bool CanExecInPlace(IExecutor *exec = CurrentExecutor()) const noexcept { return (exec == mExec) || (!mExec); }
 
         // Note: this call will invalidate "this"
-        void Dispatch() { if (mExec) mExec->Enqueue([h = mCo]() noexcept { h.resume(); }); else mCo.resume(); }
+        void Dispatch() {
+            if (mNotify) return mNotify(this).resume();
+            if (mExec) mExec->Enqueue([h = mCo]() noexcept { h.resume(); }); else mCo.resume();
+        }
+
+        // Returns the handle to transfer to if the continuation can run in place, otherwise dispatches it.
+        // Note: this call will invalidate "this"
+        std::coroutine_handle<> Transfer(IExecutor *exec = CurrentExecutor()) {
+            if (mNotify) return mNotify(this);
+            if (CanExecInPlace(exec)) return mCo;
+            return (Dispatch(), std::noop_coroutine());
+        }
 
         void SetHandle(std::coroutine_handle<> handle) noexcept { mCo = handle; }
+
+        // null for the continuations that are resumed in place
+        [[nodiscard]] IExecutor *GetExecutor() const noexcept { return mNotify ? nullptr : mExec; }
+
+        [[nodiscard]] std::coroutine_handle<> GetHandle() const noexcept { return mCo; }
     private:
         IExecutor *mExec;
+        Notify mNotify{nullptr};
         std::coroutine_handle<> mCo{};
     };
 
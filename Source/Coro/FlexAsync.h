@@ -1,9 +1,11 @@
 #pragma once
 
-#include <mutex>
-#include <memory>
-#include <Conc/SpinLock.h>
+#include <bit>
+#include <atomic>
+#include <utility>
 #include "CoroDetail.h"
+#include "FramePool.h"
+#include "Cancellation.h"
 
 namespace Coro::FlexAsync::Internal {
     using namespace Coro::Internal;
@@ -18,92 +20,157 @@ namespace Coro::FlexAsync::Internal {
 
         AwaitCoreChained *SetNext(AwaitCoreChained *next) noexcept { return mNext = next; }
 
+        AwaitCoreChained **NextSlot() noexcept { return &mNext; }
+
     private:
         AwaitCoreChained *mNext{nullptr};
     };
 
+    // The continuations are chained onto a lock-free stack, which is swapped for a sentinel once the value is set.
+    // The waiters that arrive after that find the sentinel and continue without chaining
     class ContinuationControl {
+        inline static AwaitCoreChained *INVALID_PTR = std::bit_cast<AwaitCoreChained *>(~uintptr_t(0));
     public:
         bool Transit(AwaitCoreChained *next) {
-            const auto current = CurrentExecutor();
-            if (mReady) { if (next->CanExecInPlace(current)) return false; else return (next->Dispatch(), true); }
-            else {
-                std::unique_lock lk{mContLock};
-                if (mReady) {
-                    lk.unlock(); // able to direct dispatch, no need to hold lock.
-                    if (next->CanExecInPlace(current)) return false; else return (next->Dispatch(), true);
+            auto head = mHead.load(std::memory_order_acquire);
+            do {
+                if (head == INVALID_PTR) {
+                    if (next->CanExecInPlace()) return false; else return (next->Dispatch(), true);
                 }
-                // double-checked that we cannot dispatch now, chain it to the tail
-                if (!mHead) mHead = next; else mTail->SetNext(next);
-                mTail = next;
-                return true;
-            }
+                next->SetNext(head);
+            } while (!mHead.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_acquire));
+            return true;
         }
 
         void DispatchContinuation() {
-            mReady.store(true);
-            std::unique_lock lk{mContLock};
-            auto it = mHead;
-            // as the ready flag is set, any other call using the state should not touch the cont chain
-            lk.unlock();
-            for (; it;) {
-                auto current = it;
+            auto it = mHead.exchange(INVALID_PTR, std::memory_order_acq_rel);
+            // restore the order of arrival
+            AwaitCoreChained *pending = nullptr;
+            while (it) {
+                const auto current = it;
                 it = it->GetNext();
-                current->Dispatch(); // this will invalidate the current pointer
+                current->SetNext(pending);
+                pending = current;
             }
+            DispatchBatches(pending);
         }
 
     private:
-        std::atomic_bool mReady{false};
-        Lock<SpinLock> mContLock{};
-        AwaitCoreChained *mHead{nullptr}, *mTail{nullptr};
+        std::atomic<AwaitCoreChained *> mHead{nullptr};
+
+        // Enqueues the continuations bound for the same executor as one task, and resumes the others in place
+        // after all the batches are handed out
+        static void DispatchBatches(AwaitCoreChained *pending) {
+            AwaitCoreChained *inplace = nullptr, **inplaceTail = &inplace;
+            while (pending) {
+                const auto exec = pending->GetExecutor();
+                AwaitCoreChained *batch = nullptr, **batchTail = &batch, *rest = nullptr, **restTail = &rest;
+                for (auto it = pending; it;) {
+                    const auto current = it;
+                    it = it->GetNext();
+                    current->SetNext(nullptr);
+                    auto &tail = current->GetExecutor() == exec ? batchTail : restTail;
+                    *tail = current;
+                    tail = current->NextSlot();
+                }
+                pending = rest;
+                if (!exec) {
+                    *inplaceTail = batch;
+                    inplaceTail = batchTail;
+                    continue;
+                }
+                exec->Enqueue([batch]() noexcept {
+                    for (auto it = batch; it;) {
+                        const auto handle = it->GetHandle();
+                        it = it->GetNext();
+                        handle.resume(); // this will invalidate the continuation
+                    }
+                });
+            }
+            for (auto it = inplace; it;) {
+                const auto current = it;
+                it = it->GetNext();
+                current->Dispatch(); // this will invalidate the current pointer
+            }
+        }
     };
 
+    // The state shared by the routine and the handles is embedded in the promise, so the frame is kept alive by an
+    // intrusive count of the references. The routine holds one until it reaches its final suspension, and the last
+    // one to be released destroys the frame
     template<class T>
-    using SharedContinuableValueMedia = ContinuableValueMedia<T, ContinuationControl>;
+    class SharedState : public ContinuableValueMedia<T, ContinuationControl> {
+    public:
+        template<class ...U>
+        void Set(U &&... v) {
+            this->Store(std::forward<U>(v)...);
+            this->DispatchContinuation();
+        }
 
-    template<class T>
-    using SharedContinuableValueMediaHandle = std::shared_ptr<SharedContinuableValueMedia<T>>;
+        void Fail() {
+            this->StoreFailure();
+            this->DispatchContinuation();
+        }
 
-    template<class T>
-    class PromiseValueMedia {
-    public:
-        explicit PromiseValueMedia(SharedContinuableValueMediaHandle<T> h) noexcept: mHandle(std::move(h)) {}
+        void Acquire() noexcept { mRefs.fetch_add(1, std::memory_order_relaxed); }
 
-        template<class ...U>
-        void return_value(U &&... v) { mHandle->Set(std::forward<U>(v)...); }
+        // returns true if this was the last reference, the frame is then to be destroyed by the caller
+        [[nodiscard]] bool Drop() noexcept { return mRefs.fetch_sub(1, std::memory_order_acq_rel) == 1; }
+
+        void Release() noexcept { if (Drop()) mFrame.destroy(); }
 
-        void unhandled_exception() { mHandle->Fail(); }
+    protected:
+        void SetFrame(std::coroutine_handle<> frame) noexcept { mFrame = frame; }
 
     private:
-        SharedContinuableValueMediaHandle<T> mHandle;
+        std::atomic_size_t mRefs{1};
+        std::coroutine_handle<> mFrame{};
     };
 
-    template<>
-    class PromiseValueMedia<void> {
+    template<class T>
+    struct SharedStateFinalAwait final {
+        SharedState<T> &State;
+
+        [[nodiscard]] constexpr bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> h) noexcept { if (State.Drop()) h.destroy(); }
+
+        constexpr void await_resume() const noexcept {}
+    };
+
+    template<class T>
+    class PromiseValueMedia : public SharedState<T> {
     public:
-        explicit PromiseValueMedia(SharedContinuableValueMediaHandle<void> h) noexcept: mHandle(std::move(h)) {}
+        template<class ...U>
+        void return_value(U &&... v) { this->Set(std::forward<U>(v)...); }
 
-        void return_void() { mHandle->Set(); }
+        void unhandled_exception() { this->Fail(); }
+    };
 
-        void unhandled_exception() { mHandle->Fail(); }
+    template<>
+    class PromiseValueMedia<void> : public SharedState<void> {
+    public:
+        void return_void() { Set(); }
 
-    private:
-        SharedContinuableValueMediaHandle<void> mHandle;
+        void unhandled_exception() { Fail(); }
     };
 }
 
 template<class T>
 class FlexAsync {
-    using State = Coro::FlexAsync::Internal::SharedContinuableValueMedia<T>;
-    using StateHandle = Coro::FlexAsync::Internal::SharedContinuableValueMediaHandle<T>;
+    using State = Coro::FlexAsync::Internal::SharedState<T>;
     using PromiseMedia = Coro::FlexAsync::Internal::PromiseValueMedia<T>;
 
+    // borrows the state of the handle it is created from, which outlives the co_await expression. it only takes the
+    // reference over when it is created from an expiring handle, as it may then outlive the handle
     class FlexAwaitCore : Coro::FlexAsync::Internal::AwaitCoreChained {
     public:
-        explicit FlexAwaitCore(StateHandle state) : mState(state) {}
+        FlexAwaitCore(State *state, bool owned) noexcept: mState(state), mOwned(owned) {}
+
+        FlexAwaitCore(State *state, bool owned, IExecutor *next) noexcept:
+                AwaitCoreChained(next), mState(state), mOwned(owned) {}
 
-        FlexAwaitCore(StateHandle state, IExecutor *next) noexcept: AwaitCoreChained(next), mState(state) {}
+        ~FlexAwaitCore() noexcept { if (mOwned) mState->Release(); }
 
         bool Transit(std::coroutine_handle<> h) {
             SetHandle(h);
@@ -113,38 +180,60 @@ class FlexAsync {
         T Get() { return mState->GetCopy(); }
 
     private:
-        StateHandle mState;
+        State *mState;
+        bool mOwned;
     };
 
 public:
     using Await = Coro::Internal::Await<FlexAwaitCore>;
 
-    class promise_type : public PromiseMedia {
-        static StateHandle make_state() noexcept {
-            auto alloc = temp_alloc<State>{};
-            return std::allocate_shared<State>(alloc);
-        }
-
+    class promise_type : public PromiseMedia, public Coro::Internal::PooledFrame, public Coro::Internal::CancellationAware {
     public:
-        promise_type() : PromiseMedia(make_state()) {}
+        promise_type() noexcept { this->SetFrame(std::coroutine_handle<promise_type>::from_promise(*this)); }
 
-        FlexAsync get_return_object() { return FlexAsync(this); }
+        FlexAsync get_return_object() noexcept { return (this->Acquire(), FlexAsync(this)); }
 
-        constexpr auto initial_suspend() noexcept { return std::suspend_never{}; }
+        auto initial_suspend() noexcept { return StartEagerly(); }
 
-        constexpr auto final_suspend() noexcept { return std::suspend_never{}; }
+        auto final_suspend() noexcept {
+            Leave();
+            return Coro::FlexAsync::Internal::SharedStateFinalAwait<T>{*this};
+        }
     };
 
-    auto operator co_await()&& { return Await(std::move(mState)); }
+    FlexAsync(const FlexAsync &other) noexcept: mState(other.mState) { if (mState) mState->Acquire(); }
+
+    FlexAsync(FlexAsync &&other) noexcept: mState(std::exchange(other.mState, nullptr)) {}
+
+    FlexAsync &operator=(const FlexAsync &other) noexcept {
+        if (this != &other) {
+            if (other.mState) other.mState->Acquire();
+            this->~FlexAsync();
+            mState = other.mState;
+        }
+        return *this;
+    }
+
+    FlexAsync &operator=(FlexAsync &&other) noexcept {
+        if (this != &other) {
+            this->~FlexAsync();
+            mState = std::exchange(other.mState, nullptr);
+        }
+        return *this;
+    }
+
+    ~FlexAsync() noexcept { if (mState) mState->Release(); }
+
+    auto operator co_await()&& { return Await(std::exchange(mState, nullptr), true); }
 
-    auto operator co_await() const& { return Await(mState); }
+    auto operator co_await() const& { return Await(mState, false); }
 
-    auto Configure(IExecutor *next) &&{ return Await(std::move(mState), next); }
+    auto Configure(IExecutor *next) &&{ return Await(std::exchange(mState, nullptr), true, next); }
 
-    auto Configure(IExecutor *next) const &{ return Await(mState, next); }
+    auto Configure(IExecutor *next) const &{ return Await(mState, false, next); }
 
 private:
-    StateHandle mState;
+    State *mState;
 
-    explicit FlexAsync(std::shared_ptr<State> state) noexcept: mState(std::move(state)) {}
+    explicit FlexAsync(State *state) noexcept: mState(state) {}
 };
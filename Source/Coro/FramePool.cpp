@@ -0,0 +1,169 @@
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include "FramePool.h"
+
+namespace {
+    constexpr std::size_t Granularity = 64;
+    // frames up to 4KiB are pooled, in buckets of 64 bytes
+    constexpr std::size_t Classes = 64;
+    // the frames freed on the owning thread beyond this count are returned to the global heap
+    constexpr std::size_t CachedPerClass = 256;
+
+    class Pool;
+
+    // prepended to every frame. when a frame is cached, the link to the next one is kept in the first word after
+    // the header, so the header stays valid as long as the memory is owned by the pool
+    struct alignas(std::max_align_t) Header {
+        Pool *Owner;
+        std::size_t Class;
+
+        Header *&Next() noexcept { return *reinterpret_cast<Header **>(this + 1); }
+    };
+
+    class Pool {
+        struct Bucket {
+            Header *Head{nullptr};
+            std::size_t Count{0};
+        };
+
+        inline static Header *const Closed = reinterpret_cast<Header *>(uintptr_t(1));
+        inline static thread_local Pool *tCurrent{nullptr};
+        // 0: not yet created, 1: alive, 2: the thread is exiting
+        inline static thread_local int tState{0};
+    public:
+        static Pool *Current() noexcept {
+            if (tState == 0) {
+                static thread_local Holder holder{};
+            }
+            return tCurrent;
+        }
+
+        static Pool *Peek() noexcept { return tCurrent; }
+
+        Header *Take(std::size_t cls) noexcept {
+            auto &bucket = mBuckets[cls];
+            if (!bucket.Head) Collect();
+            const auto header = bucket.Head;
+            if (header) {
+                bucket.Head = header->Next();
+                --bucket.Count;
+            }
+            return header;
+        }
+
+        void Push(Header *header) noexcept {
+            auto &bucket = mBuckets[header->Class];
+            if (bucket.Count >= CachedPerClass) return ::operator delete(header);
+            header->Next() = bucket.Head;
+            bucket.Head = header;
+            ++bucket.Count;
+        }
+
+        // a pool that is not owned by any thread closes its remote list, the frames are then freed directly
+        void PushRemote(Header *header) noexcept {
+            auto head = mRemote.load(std::memory_order_relaxed);
+            do {
+                if (head == Closed) return ::operator delete(header);
+                header->Next() = head;
+            } while (!mRemote.compare_exchange_weak(head, header, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+    private:
+        // the frames held by the pool of an exited thread are released, and the pool itself is kept for reuse
+        // by the next thread, as frames allocated from it may still be freed anywhere
+        struct Registry {
+            std::mutex Lock;
+            std::vector<Pool *> Orphans;
+
+            static Registry &Get() noexcept {
+                // leaked on purpose, the threads may exit during or after static destruction
+                static auto &registry = *new Registry();
+                return registry;
+            }
+        };
+
+        struct Holder {
+            Holder() noexcept {
+                tCurrent = Adopt();
+                tState = 1;
+            }
+
+            ~Holder() noexcept {
+                tState = 2;
+                const auto pool = std::exchange(tCurrent, nullptr);
+                pool->Close();
+                auto &registry = Registry::Get();
+                std::lock_guard lk{registry.Lock};
+                registry.Orphans.push_back(pool);
+            }
+        };
+
+        alignas(64) std::atomic<Header *> mRemote{nullptr};
+        alignas(64) Bucket mBuckets[Classes]{};
+
+        static Pool *Adopt() noexcept {
+            {
+                auto &registry = Registry::Get();
+                std::lock_guard lk{registry.Lock};
+                if (!registry.Orphans.empty()) {
+                    const auto pool = registry.Orphans.back();
+                    registry.Orphans.pop_back();
+                    pool->mRemote.store(nullptr, std::memory_order_release);
+                    return pool;
+                }
+            }
+            return new Pool();
+        }
+
+        // the remote list is only ever taken as a whole, so the pushes cannot suffer from ABA
+        void Collect() noexcept {
+            for (auto it = mRemote.exchange(nullptr, std::memory_order_acquire); it;) {
+                const auto header = it;
+                it = it->Next();
+                auto &bucket = mBuckets[header->Class];
+                header->Next() = bucket.Head;
+                bucket.Head = header;
+                ++bucket.Count;
+            }
+        }
+
+        static void Release(Header *it) noexcept {
+            while (it) ::operator delete(std::exchange(it, it->Next()));
+        }
+
+        void Close() noexcept {
+            for (auto &bucket: mBuckets) {
+                Release(std::exchange(bucket.Head, nullptr));
+                bucket.Count = 0;
+            }
+            Release(mRemote.exchange(Closed, std::memory_order_acquire));
+        }
+    };
+}
+
+void *Coro::Internal::AllocateFrame(std::size_t size) {
+    const auto total = size + sizeof(Header);
+    const auto cls = (total - 1) / Granularity;
+    Pool *owner = nullptr;
+    Header *header = nullptr;
+    if (cls < Classes) {
+        if ((owner = Pool::Current())) header = owner->Take(cls);
+        if (!header) header = static_cast<Header *>(::operator new((cls + 1) * Granularity));
+    }
+    else header = static_cast<Header *>(::operator new(total));
+    header->Owner = owner;
+    header->Class = cls;
+    return header + 1;
+}
+
+void Coro::Internal::FreeFrame(void *frame) noexcept {
+    if (!frame) return;
+    const auto header = static_cast<Header *>(frame) - 1;
+    const auto owner = header->Owner;
+    if (!owner) return ::operator delete(header);
+    if (owner == Pool::Peek()) owner->Push(header); else owner->PushRemote(header);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+
+namespace Coro::Internal {
+    // Allocates a coroutine frame from the size-bucketed pool of the calling thread. The frames that are too large
+    // to be pooled, or allocated while the thread is exiting, come from the global heap
+    [[nodiscard]] void *AllocateFrame(std::size_t size);
+
+    // Returns a frame to the pool it was taken from. A frame freed on another thread is pushed to the lock-free
+    // remote list of its owning pool, which the owner collects when its local bucket runs empty
+    void FreeFrame(void *frame) noexcept;
+
+    // mixed into promise types so that the frames of their coroutines are allocated from the frame pools
+    struct PooledFrame {
+        static void *operator new(std::size_t size) { return AllocateFrame(size); }
+
+        static void operator delete(void *frame) noexcept { FreeFrame(frame); }
+    };
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <utility>
+#include "CoroDetail.h"
+#include "FramePool.h"
+#include "ValueAsync.h"
+#include "Cancellation.h"
+
+namespace Coro::LazyAsync::Internal {
+    using namespace Coro::Internal;
+
+    // the continuation is the single awaiting party, which also owns the frame once the task is started
+    class PromiseBase : public PooledFrame, public CancellationAware {
+        struct FinalAwait {
+            AwaitCore *Next;
+
+            [[nodiscard]] constexpr bool await_ready() const noexcept { return false; }
+
+            // the frame may be destroyed as soon as the continuation is dispatched, it is not touched afterwards
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<>) noexcept { return Next->Transfer(); }
+
+            constexpr void await_resume() const noexcept {}
+        };
+    public:
+        auto initial_suspend() noexcept { return StartLazily(); }
+
+        auto final_suspend() noexcept {
+            Leave();
+            return FinalAwait{mNext};
+        }
+
+        void SetContinuation(AwaitCore *next) noexcept { mNext = next; }
+
+    private:
+        AwaitCore *mNext{nullptr};
+    };
+
+    template<class T>
+    struct Promise : PromiseBase, ValueStore<T> {
+        template<class ...U>
+        void return_value(U &&... v) { ValueStore<T>::Set(std::forward<U>(v)...); }
+
+        void unhandled_exception() { ValueStore<T>::Fail(std::current_exception()); }
+    };
+
+    template<>
+    struct Promise<void> : PromiseBase, ValueStore<void> {
+        void return_void() { ValueStore<void>::Set(); }
+
+        void unhandled_exception() { ValueStore<void>::Fail(std::current_exception()); }
+    };
+
+    class Hop {
+    public:
+        explicit Hop(IExecutor *next) noexcept: mNext(next) {}
+
+        [[nodiscard]] bool await_ready() const noexcept { return !mNext; }
+
+        void await_suspend(std::coroutine_handle<> h) { mNext->Enqueue([h]() noexcept { h.resume(); }); }
+
+        constexpr void await_resume() const noexcept {}
+
+    private:
+        IExecutor *mNext;
+    };
+}
+
+// A lazily started coroutine. The body does not run until the task is awaited, which starts it in place on the
+// awaiting thread through symmetric transfer, or until it is started explicitly. The task owns the frame and can be
+// awaited only once
+template<class T>
+class LazyAsync {
+    using Promise = Coro::LazyAsync::Internal::Promise<T>;
+public:
+    struct promise_type : Promise {
+        LazyAsync get_return_object() { return LazyAsync(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+    class Await : Coro::Internal::AwaitCore {
+    public:
+        explicit Await(Handle h) noexcept: mHandle(h) {}
+
+        Await(Handle h, IExecutor *next) noexcept: AwaitCore(next), mHandle(h) {}
+
+        ~Await() noexcept { if (mHandle) mHandle.destroy(); }
+
+        [[nodiscard]] constexpr bool await_ready() const noexcept { return false; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) noexcept {
+            SetHandle(h);
+            mHandle.promise().SetContinuation(this);
+            return mHandle;
+        }
+
+        T await_resume() { return mHandle.promise().Get(); }
+
+    private:
+        Handle mHandle;
+    };
+
+    constexpr LazyAsync() noexcept = default;
+
+    LazyAsync(LazyAsync &&other) noexcept: mHandle(std::exchange(other.mHandle, nullptr)) {}
+
+    LazyAsync(const LazyAsync &other) = delete;
+
+    LazyAsync &operator=(LazyAsync &&other) noexcept {
+        this->~LazyAsync();
+        mHandle = std::exchange(other.mHandle, nullptr);
+        return *this;
+    }
+
+    LazyAsync &operator=(const LazyAsync &other) = delete;
+
+    // a task that has never been started is destroyed along with its frame
+    ~LazyAsync() noexcept { if (mHandle) mHandle.destroy(); }
+
+    auto operator co_await()&& { return Await(std::exchange(mHandle, nullptr)); }
+
+    auto Configure(IExecutor *next) &&{ return Await(std::exchange(mHandle, nullptr), next); }
+
+    // starts the task on the executor, or in place if none is given. the result is awaited through the returned
+    // ValueAsync, which runs eagerly
+    ValueAsync<T> Start(IExecutor *exec = nullptr) && { return Run(std::move(*this), exec); }
+
+private:
+    Handle mHandle{nullptr};
+
+    explicit LazyAsync(Handle handle) noexcept: mHandle(handle) {}
+
+    static ValueAsync<T> Run(LazyAsync task, IExecutor *exec) {
+        Coro::LazyAsync::Internal::Hop hop{exec};
+        co_await hop;
+        co_return co_await std::move(task);
+    }
+};
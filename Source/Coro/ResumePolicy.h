@@ -0,0 +1,94 @@
+#pragma once
+
+#include <coroutine>
+#include "CoroDetail.h"
+
+// Policies deciding where an awaiting coroutine is resumed, to be passed to ValueAsync::Configure. Without one, the
+// coroutine is resumed in place when the awaited operation completes on the executor it was running on, and is
+// otherwise dispatched back to that executor
+namespace Resume {
+    // always resumed in place on the thread completing the operation, never dispatched
+    struct Inline {};
+
+    // resumed in place only when the operation completes on the very thread the coroutine suspended on, and is
+    // otherwise dispatched back to the executor it was running on. The executors cannot be asked for a particular
+    // worker, so the coroutine is only kept on its thread when the completion does not leave it
+    struct SameThread {};
+
+    // resumed in place on any worker of the pool, otherwise dispatched to the pool. The same as Configure(Pool)
+    struct AnyWorker {
+        IExecutor *Pool;
+    };
+
+    // resumed in place like Inline, until this many coroutines have been resumed in place in a row on the thread
+    // under this policy, then dispatched to the fallback to bound the depth of the stack. The row is broken when a
+    // coroutine awaiting under this policy suspends, as the thread unwinds back to the one that resumed it, and when
+    // a dispatched coroutine starts afresh from the executor. The fallback defaults to the executor the coroutine was
+    // running on, a coroutine without an executor is always resumed in place
+    struct InlineAtMost {
+        unsigned Limit;
+        IExecutor *Fallback{nullptr};
+    };
+}
+
+namespace Coro::Internal {
+    // the base of an awaiter implementing a resume policy, specialized for each one of them. Those that need to
+    // decide on completion are notified in place of the coroutine, and return the handle to transfer to
+    template<class Policy>
+    class ResumeCore;
+
+    template<>
+    class ResumeCore<Resume::Inline> : public AwaitCore {
+    public:
+        explicit ResumeCore(Resume::Inline) noexcept: AwaitCore(static_cast<IExecutor *>(nullptr)) {}
+    };
+
+    template<>
+    class ResumeCore<Resume::AnyWorker> : public AwaitCore {
+    public:
+        explicit ResumeCore(Resume::AnyWorker policy) noexcept: AwaitCore(policy.Pool) {}
+    };
+
+    template<>
+    class ResumeCore<Resume::SameThread> : public AwaitCore {
+        inline static thread_local char tMark{};
+    public:
+        explicit ResumeCore(Resume::SameThread) noexcept:
+                AwaitCore(&OnReady), mThread(&tMark), mHome(CurrentExecutor()) {}
+
+    private:
+        const char *mThread;
+        IExecutor *mHome;
+
+        static std::coroutine_handle<> OnReady(AwaitCore *core) noexcept {
+            const auto ths = static_cast<ResumeCore *>(core);
+            if (ths->mThread == &tMark || !ths->mHome) return ths->GetHandle();
+            ths->mHome->Enqueue([h = ths->GetHandle()]() noexcept { h.resume(); });
+            return std::noop_coroutine();
+        }
+    };
+
+    template<>
+    class ResumeCore<Resume::InlineAtMost> : public AwaitCore {
+        inline static thread_local unsigned tInlined{0};
+    public:
+        explicit ResumeCore(Resume::InlineAtMost policy) noexcept:
+                AwaitCore(&OnReady), mLimit(policy.Limit),
+                mFallback(policy.Fallback ? policy.Fallback : CurrentExecutor()) {}
+
+        // called on the thread the awaiting coroutine suspends on, which unwinds back to the one that resumed it
+        static void OnSuspend() noexcept { tInlined = 0; }
+
+    private:
+        unsigned mLimit;
+        IExecutor *mFallback;
+
+        static std::coroutine_handle<> OnReady(AwaitCore *core) noexcept {
+            const auto ths = static_cast<ResumeCore *>(core);
+            if (tInlined < ths->mLimit || !ths->mFallback) return (++tInlined, ths->GetHandle());
+            tInlined = 0;
+            ths->mFallback->Enqueue([h = ths->GetHandle()]() noexcept { (tInlined = 0, h.resume()); });
+            return std::noop_coroutine();
+        }
+    };
+}
@@ -0,0 +1,103 @@
+#include "Sync.h"
+#include <algorithm>
+
+bool AsyncMutex::Enqueue(Waiter *waiter) noexcept {
+    auto state = mState.load(std::memory_order_relaxed);
+    for (;;) {
+        if (state == this) {
+            // unlocked in the meantime, take it without suspending
+            if (mState.compare_exchange_weak(state, nullptr, std::memory_order_acquire, std::memory_order_relaxed)) {
+                return false;
+            }
+            continue;
+        }
+        waiter->Next = static_cast<Waiter *>(state);
+        if (mState.compare_exchange_weak(state, waiter, std::memory_order_release, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+void AsyncMutex::Unlock() {
+    auto next = mWaiters;
+    if (!next) {
+        void *expected = nullptr;
+        if (mState.compare_exchange_strong(expected, this, std::memory_order_release, std::memory_order_relaxed)) {
+            return;
+        }
+        // take the arrivals and put them in order, the state stays locked for the one to be handed over to
+        next = Waiter::Reverse(static_cast<Waiter *>(mState.exchange(nullptr, std::memory_order_acquire)));
+    }
+    mWaiters = next->Next;
+    next->Dispatch(); // this will invalidate the waiter
+}
+
+bool AsyncSemaphore::TryAcquire() noexcept {
+    auto count = mCount.load(std::memory_order_relaxed);
+    while (count > 0) {
+        if (mCount.compare_exchange_weak(count, count - 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool AsyncSemaphore::Enqueue(Waiter *waiter) {
+    if (mCount.fetch_sub(1, std::memory_order_acq_rel) > 0) return false;
+    // counted as a waiter, a release from now on owes it a unit which is handed over once it is put in order
+    auto head = mArrivals.load(std::memory_order_relaxed);
+    do waiter->Next = head;
+    while (!mArrivals.compare_exchange_weak(head, waiter, std::memory_order_release, std::memory_order_relaxed));
+    Signal();
+    return true;
+}
+
+void AsyncSemaphore::Release(size_t count) {
+    const auto waiting = -mCount.fetch_add(static_cast<ptrdiff_t>(count), std::memory_order_acq_rel);
+    if (waiting <= 0) return;
+    mGranted.fetch_add(std::min(count, static_cast<size_t>(waiting)), std::memory_order_relaxed);
+    Signal();
+}
+
+void AsyncSemaphore::Signal() {
+    if (mPending.fetch_add(1, std::memory_order_acq_rel) == 0) HandOver();
+}
+
+void AsyncSemaphore::HandOver() {
+    Waiter *admitted = nullptr, *last = nullptr;
+    auto pending = mPending.load(std::memory_order_acquire);
+    do {
+        mOwed += mGranted.exchange(0, std::memory_order_relaxed);
+        // the latest arrival becomes the tail once the stack is reversed
+        if (const auto arrivals = mArrivals.exchange(nullptr, std::memory_order_acquire); arrivals) {
+            const auto first = Waiter::Reverse(arrivals);
+            if (mTail) mTail->Next = first; else mHead = first;
+            mTail = arrivals;
+        }
+        for (; mOwed && mHead; --mOwed) {
+            const auto waiter = mHead;
+            if (!(mHead = waiter->Next)) mTail = nullptr;
+            waiter->Next = nullptr;
+            if (last) last->Next = waiter; else admitted = waiter;
+            last = waiter;
+        }
+        // the ones that signal meanwhile see a non-zero count and leave their work to this loop
+    } while (!mPending.compare_exchange_weak(pending, 0, std::memory_order_acq_rel, std::memory_order_acquire));
+    // resumed after giving up the hand over, a waiter may release the semaphore again in place
+    Waiter::DispatchAll(admitted);
+}
+
+bool AsyncManualResetEvent::Enqueue(Waiter *waiter) noexcept {
+    auto state = mState.load(std::memory_order_acquire);
+    do {
+        if (state == this) return false;
+        waiter->Next = static_cast<Waiter *>(state);
+    } while (!mState.compare_exchange_weak(state, waiter, std::memory_order_acq_rel, std::memory_order_acquire));
+    return true;
+}
+
+void AsyncManualResetEvent::Set() {
+    const auto state = mState.exchange(this, std::memory_order_acq_rel);
+    if (state == this) return;
+    Waiter::DispatchAll(Waiter::Reverse(static_cast<Waiter *>(state)));
+}
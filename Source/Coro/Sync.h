@@ -0,0 +1,231 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include "CoroDetail.h"
+
+namespace Coro::Sync::Internal {
+    using namespace Coro::Internal;
+
+    // a suspended coroutine chained into the intrusive list of a primitive. the waiter lives in the frame of the
+    // coroutine and is resumed through the executor it captured when it started waiting
+    class Waiter : public AwaitCore {
+    public:
+        Waiter *Next{nullptr};
+
+        [[nodiscard]] static Waiter *Reverse(Waiter *it) noexcept {
+            Waiter *result = nullptr;
+            while (it) result = std::exchange(it, std::exchange(it->Next, result));
+            return result;
+        }
+
+        // Note: this will invalidate all the waiters in the list
+        static void DispatchAll(Waiter *it) {
+            while (it) std::exchange(it, it->Next)->Dispatch();
+        }
+    };
+}
+
+// A mutex that suspends the awaiting coroutine instead of blocking the thread. The lock is handed over to the waiters
+// in the order they arrived, an unlock never lets a newcomer barge in front of them. The arrivals are pushed onto a
+// lock-free stack, which the holder reverses into its private queue when it unlocks
+class AsyncMutex {
+    using Waiter = Coro::Sync::Internal::Waiter;
+
+    class LockAwait : Waiter {
+    public:
+        explicit LockAwait(AsyncMutex &mutex) noexcept: mMutex(mutex) {}
+
+        [[nodiscard]] bool await_ready() noexcept { return mMutex.TryLock(); }
+
+        bool await_suspend(std::coroutine_handle<> h) noexcept {
+            SetHandle(h);
+            return mMutex.Enqueue(this);
+        }
+
+        constexpr void await_resume() const noexcept {}
+
+    protected:
+        AsyncMutex &mMutex;
+    };
+public:
+    // unlocks the mutex when it goes out of scope
+    class Guard {
+    public:
+        explicit Guard(AsyncMutex *mutex) noexcept: mMutex(mutex) {}
+
+        Guard(Guard &&other) noexcept: mMutex(std::exchange(other.mMutex, nullptr)) {}
+
+        Guard &operator=(Guard &&other) noexcept {
+            if (this != &other) {
+                this->~Guard();
+                mMutex = std::exchange(other.mMutex, nullptr);
+            }
+            return *this;
+        }
+
+        ~Guard() noexcept { if (mMutex) mMutex->Unlock(); }
+
+    private:
+        AsyncMutex *mMutex;
+    };
+
+    AsyncMutex() noexcept = default;
+
+    AsyncMutex(const AsyncMutex &) = delete;
+
+    AsyncMutex &operator=(const AsyncMutex &) = delete;
+
+    [[nodiscard]] bool TryLock() noexcept {
+        void *expected = this;
+        return mState.compare_exchange_strong(expected, nullptr, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    auto Lock() noexcept { return LockAwait(*this); }
+
+    auto ScopedLock() noexcept {
+        struct ScopedAwait : LockAwait {
+            using LockAwait::LockAwait;
+
+            Guard await_resume() const noexcept { return Guard(&mMutex); }
+        };
+        return ScopedAwait(*this);
+    }
+
+    void Unlock();
+
+private:
+    // this when not locked, null when locked without waiters, otherwise the latest arrival
+    std::atomic<void *> mState{this};
+    // the waiters in order of arrival, only accessed by the holder
+    Waiter *mWaiters{nullptr};
+
+    bool Enqueue(Waiter *waiter) noexcept;
+};
+
+// A counting semaphore that suspends the awaiting coroutine until a unit is available. The units released are handed
+// to the waiters in the order they arrived before they become available to others. The count is kept in an atomic,
+// the arrivals are pushed onto a lock-free stack, and whoever finds work to do first becomes the one to reverse them
+// into its private queue and hand the units owed over, like the holder of AsyncMutex does
+class AsyncSemaphore {
+    using Waiter = Coro::Sync::Internal::Waiter;
+
+    class AcquireAwait : Waiter {
+    public:
+        explicit AcquireAwait(AsyncSemaphore &semaphore) noexcept: mSemaphore(semaphore) {}
+
+        [[nodiscard]] constexpr bool await_ready() const noexcept { return false; }
+
+        bool await_suspend(std::coroutine_handle<> h) {
+            SetHandle(h);
+            return mSemaphore.Enqueue(this);
+        }
+
+        constexpr void await_resume() const noexcept {}
+
+    private:
+        AsyncSemaphore &mSemaphore;
+    };
+public:
+    explicit AsyncSemaphore(size_t initial) noexcept: mCount(static_cast<ptrdiff_t>(initial)) {}
+
+    AsyncSemaphore(const AsyncSemaphore &) = delete;
+
+    AsyncSemaphore &operator=(const AsyncSemaphore &) = delete;
+
+    [[nodiscard]] bool TryAcquire() noexcept;
+
+    auto Acquire() noexcept { return AcquireAwait(*this); }
+
+    void Release(size_t count = 1);
+
+    [[nodiscard]] size_t Available() const noexcept {
+        const auto count = mCount.load(std::memory_order_relaxed);
+        return count > 0 ? static_cast<size_t>(count) : 0;
+    }
+
+private:
+    // the units available, or the negated number of the waiters that no unit has been released to yet
+    std::atomic<ptrdiff_t> mCount;
+    // the latest arrival that has not been put in order yet
+    std::atomic<Waiter *> mArrivals{nullptr};
+    // the units released to the waiters since they were last handed over
+    std::atomic<size_t> mGranted{0};
+    // the arrivals and the releases yet to be looked at, the one raising it from zero hands the units over
+    std::atomic<size_t> mPending{0};
+    // the waiters in order of arrival and the units owed to them, only accessed by the one handing over
+    Waiter *mHead{nullptr}, *mTail{nullptr};
+    size_t mOwed{0};
+
+    bool Enqueue(Waiter *waiter);
+
+    void Signal();
+
+    void HandOver();
+};
+
+// An event that releases all the waiting coroutines when it is set, and lets the later ones pass until it is reset.
+// The waiters are pushed onto a lock-free stack
+class AsyncManualResetEvent {
+    using Waiter = Coro::Sync::Internal::Waiter;
+
+    class WaitAwait : Waiter {
+    public:
+        explicit WaitAwait(AsyncManualResetEvent &event) noexcept: mEvent(event) {}
+
+        [[nodiscard]] bool await_ready() const noexcept { return mEvent.IsSet(); }
+
+        bool await_suspend(std::coroutine_handle<> h) noexcept {
+            SetHandle(h);
+            return mEvent.Enqueue(this);
+        }
+
+        constexpr void await_resume() const noexcept {}
+
+    private:
+        AsyncManualResetEvent &mEvent;
+    };
+public:
+    explicit AsyncManualResetEvent(bool set = false) noexcept: mState(set ? this : nullptr) {}
+
+    AsyncManualResetEvent(const AsyncManualResetEvent &) = delete;
+
+    AsyncManualResetEvent &operator=(const AsyncManualResetEvent &) = delete;
+
+    [[nodiscard]] bool IsSet() const noexcept { return mState.load(std::memory_order_acquire) == this; }
+
+    auto Wait() noexcept { return WaitAwait(*this); }
+
+    void Set();
+
+    // has no effect on an event that is not set
+    void Reset() noexcept {
+        void *expected = this;
+        mState.compare_exchange_strong(expected, nullptr, std::memory_order_relaxed);
+    }
+
+private:
+    // this when set, otherwise the latest waiter
+    std::atomic<void *> mState;
+
+    bool Enqueue(Waiter *waiter) noexcept;
+};
+
+// A single-use barrier that releases the waiting coroutines once it has been counted down to zero
+class AsyncLatch {
+public:
+    explicit AsyncLatch(ptrdiff_t count) noexcept: mCount(count), mEvent(count <= 0) {}
+
+    void CountDown(ptrdiff_t count = 1) {
+        if (mCount.fetch_sub(count, std::memory_order_acq_rel) <= count) mEvent.Set();
+    }
+
+    [[nodiscard]] bool IsReady() const noexcept { return mEvent.IsSet(); }
+
+    auto Wait() noexcept { return mEvent.Wait(); }
+
+private:
+    std::atomic<ptrdiff_t> mCount;
+    AsyncManualResetEvent mEvent;
+};
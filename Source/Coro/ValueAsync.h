@@ -2,8 +2,12 @@
 
 #include <atomic>
 #include <memory>
+#include <type_traits>
 #include <Common/ScopeGuard.h>
 #include "CoroDetail.h"
+#include "FramePool.h"
+#include "Cancellation.h"
+#include "ResumePolicy.h"
 
 namespace Coro::ValueAsync::Internal {
     using namespace Coro::Internal;
@@ -46,17 +50,26 @@ namespace Coro::ValueAsync::Internal {
             }
         }
 
-        void DispatchContinuation() { if (auto ths = mNext.exchange(INVALID_PTR); ths) ths->Dispatch(); }
+        // marks the state as finalized, and takes the continuation that has been chained if there is one
+        AwaitCore *Finalize() noexcept { return mNext.exchange(INVALID_PTR); }
     private:
         std::atomic<AwaitCore *> mNext{nullptr};
     };
 
+    // Finalizes the state and transfers to the continuation symmetrically when it can run in place, so that a
+    // chain of inline completions runs in constant stack. The continuation is taken before the frame is handed
+    // over to the client, as the client may destroy the frame as soon as it is handed over
     struct StateLifeCycleRoutineFinalAwait final {
-        StateLifeCycleControl& Control;
+        ContinuationControl& Control;
 
         [[nodiscard]] constexpr bool await_ready() const noexcept { return false; }
 
-        bool await_suspend(std::coroutine_handle<> h) noexcept { return Control.RoutineRelease(h); }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) noexcept {
+            const auto next = Control.Finalize();
+            const auto target = next ? next->Transfer() : std::noop_coroutine();
+            if (!Control.RoutineRelease(h)) h.destroy(); // client state released, the frame is ours to destroy
+            return target;
+        }
 
         constexpr void await_resume() const noexcept {}
     };
@@ -67,16 +80,16 @@ namespace Coro::ValueAsync::Internal {
     template<class T>
     struct ValuePromiseValueMedia : public ValueContinuableValueMedia<T> {
         template<class ...U>
-        void return_value(U &&... v) { ValueContinuableValueMedia<T>::Set(std::forward<U>(v)...); }
+        void return_value(U &&... v) { ValueContinuableValueMedia<T>::Store(std::forward<U>(v)...); }
 
-        void unhandled_exception() { ValueContinuableValueMedia<T>::Fail(); }
+        void unhandled_exception() { ValueContinuableValueMedia<T>::StoreFailure(); }
     };
 
     template<>
     struct ValuePromiseValueMedia<void> : public ValueContinuableValueMedia<void> {
-        void return_void() { ValueContinuableValueMedia<void>::Set(); }
+        void return_void() { ValueContinuableValueMedia<void>::Store(); }
 
-        void unhandled_exception() { ValueContinuableValueMedia<void>::Fail(); }
+        void unhandled_exception() { ValueContinuableValueMedia<void>::StoreFailure(); }
     };
 }
 
@@ -85,15 +98,19 @@ class ValueAsync {
     using Media = Coro::ValueAsync::Internal::ValueContinuableValueMedia<T>;
     using PromiseMedia = Coro::ValueAsync::Internal::ValuePromiseValueMedia<T>;
 
-    class ValueAwaitCore: Coro::Internal::AwaitCore {
+    // the base decides where the awaiting coroutine is resumed, and is constructed from the arguments after the media
+    template<class Base>
+    class ValueAwaitCore: Base {
     public:
-        explicit ValueAwaitCore(Media* media): mMedia(media) {}
-
-        ValueAwaitCore(Media* media, IExecutor *next) noexcept: AwaitCore(next), mMedia(media) {}
+        template<class ...U>
+        explicit ValueAwaitCore(Media* media, U &&... base) noexcept: Base(std::forward<U>(base)...), mMedia(media) {}
 
         bool Transit(std::coroutine_handle<> h) {
-            SetHandle(h);
-            return mMedia->Transit(this);
+            this->SetHandle(h);
+            const auto suspended = mMedia->Transit(this);
+            // the awaiter may have been resumed elsewhere by now, only the static hook of the base is called
+            if constexpr (requires { Base::OnSuspend(); }) if (suspended) Base::OnSuspend();
+            return suspended;
         }
 
         T Get() {
@@ -103,15 +120,21 @@ class ValueAsync {
     private:
         Media* mMedia;
     };
+
+    template<class Base>
+    using AwaitOn = Coro::Internal::Await<ValueAwaitCore<Base>>;
 public:
-    using Await = Coro::Internal::Await<ValueAwaitCore>;
+    using Await = AwaitOn<Coro::Internal::AwaitCore>;
 
-    struct promise_type : public PromiseMedia {
+    struct promise_type : public PromiseMedia, public Coro::Internal::PooledFrame, public Coro::Internal::CancellationAware {
         ValueAsync get_return_object() { return ValueAsync(this); }
 
-        constexpr auto initial_suspend() noexcept { return std::suspend_never{}; }
+        auto initial_suspend() noexcept { return StartEagerly(); }
 
-        auto final_suspend() noexcept { return Coro::ValueAsync::Internal::StateLifeCycleRoutineFinalAwait{*this}; }
+        auto final_suspend() noexcept {
+            Leave();
+            return Coro::ValueAsync::Internal::StateLifeCycleRoutineFinalAwait{*this};
+        }
     };
 
     constexpr ValueAsync() noexcept = default;
@@ -134,6 +157,22 @@ public:
 
     auto Configure(IExecutor *next) &&{ return Await(std::exchange(mMedia, nullptr), next); }
 
+    // resumes the awaiting coroutine as decided by one of the policies in the Resume namespace
+    template<class Policy> requires std::is_class_v<Policy>
+    auto Configure(Policy policy) &&{
+        return AwaitOn<Coro::Internal::ResumeCore<Policy>>(std::exchange(mMedia, nullptr), policy);
+    }
+
+    // Chains a node that is notified when the value is ready, in place of an awaiting coroutine. Returns false
+    // without chaining if the value is ready already. The value is collected with Take() afterwards
+    bool Chain(Coro::Internal::AwaitCore *node) { return mMedia->Transit(node); }
+
+    T Take() && {
+        const auto media = std::exchange(mMedia, nullptr);
+        const auto scope = ScopeGuard([media]() noexcept { media->ClientRelease(); });
+        return media->Get();
+    }
+
 private:
     Media *mMedia{nullptr};
 
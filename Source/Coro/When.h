@@ -0,0 +1,204 @@
+#pragma once
+
+#include <atomic>
+#include <ranges>
+#include <utility>
+#include <stdexcept>
+#include <Temp/Vector.h>
+#include "ValueAsync.h"
+#include "Cancellation.h"
+
+namespace Coro::When::Internal {
+    using namespace Coro::Internal;
+
+    template<class Async>
+    struct ValueOf;
+
+    template<class T>
+    struct ValueOf<::ValueAsync<T>> { using Type = T; };
+
+    template<class T>
+    struct AllOf { using Type = temp::vector<T>; };
+
+    template<>
+    struct AllOf<void> { using Type = void; };
+
+    template<class T>
+    struct AnyOf { using Type = std::pair<size_t, T>; };
+
+    template<>
+    struct AnyOf<void> { using Type = size_t; };
+
+    // Awaited once by the combinator, which is resumed when all the arrivals are counted. The count starts one
+    // above the number of arrivals, the extra one is taken when the combinator has suspended
+    class Countdown : public AwaitCore {
+    public:
+        explicit Countdown(size_t count) noexcept: mCount(count + 1) {}
+
+        // returns the combinator to transfer to if this is the last arrival
+        std::coroutine_handle<> Arrive() noexcept {
+            if (mCount.fetch_sub(1, std::memory_order_acq_rel) == 1) return Transfer();
+            return std::noop_coroutine();
+        }
+
+        // an arrival that has been counted before the combinator suspends
+        void Skip() noexcept { mCount.fetch_sub(1, std::memory_order_relaxed); }
+
+        [[nodiscard]] constexpr bool await_ready() const noexcept { return false; }
+
+        bool await_suspend(std::coroutine_handle<> h) noexcept {
+            SetHandle(h);
+            return mCount.fetch_sub(1, std::memory_order_acq_rel) != 1;
+        }
+
+        constexpr void await_resume() const noexcept {}
+
+    private:
+        std::atomic_size_t mCount;
+    };
+
+    class AllNode : public AwaitCore {
+    public:
+        AllNode() noexcept: AwaitCore(&OnReady) {}
+
+        Countdown *Counter{nullptr};
+
+    private:
+        static std::coroutine_handle<> OnReady(AwaitCore *node) noexcept {
+            return static_cast<AllNode *>(node)->Counter->Arrive();
+        }
+    };
+
+    // The state of WhenAny is shared with the losers, which may complete long after the combinator returns. It is
+    // released by the last of the combinator and the arrivals
+    template<class Async>
+    class AnyState : public AwaitCore {
+        class Node : public AwaitCore {
+        public:
+            Node() noexcept: AwaitCore(&OnReady) {}
+
+            AnyState *State{nullptr};
+            size_t Index{0};
+
+        private:
+            static std::coroutine_handle<> OnReady(AwaitCore *node) noexcept {
+                const auto ths = static_cast<Node *>(node);
+                const auto state = ths->State;
+                const auto next = state->Arrive(ths->Index);
+                state->Release(); // this may invalidate the node
+                return next;
+            }
+        };
+    public:
+        static constexpr size_t None = ~size_t(0);
+
+        template<class Range>
+        static AnyState *Create(Range &tasks) {
+            auto alloc = temp_alloc<AnyState>{};
+            return allocator_construct<AnyState>(alloc, tasks);
+        }
+
+        template<class Range>
+        explicit AnyState(Range &tasks) {
+            for (auto &&task: tasks) mTasks.push_back(std::move(task));
+            mNodes = temp::make_unique<Node[]>(mTasks.size());
+            mRefs.store(mTasks.size() + 1, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] size_t Size() const noexcept { return mTasks.size(); }
+
+        // the tasks that are ready already are counted in place, and cannot resume the combinator as it has not
+        // passed the gate yet
+        void Start() {
+            for (size_t i = 0; i < mTasks.size(); ++i) {
+                mNodes[i].State = this;
+                mNodes[i].Index = i;
+                if (!mTasks[i].Chain(&mNodes[i])) {
+                    Arrive(i);
+                    Release();
+                }
+            }
+        }
+
+        [[nodiscard]] constexpr bool await_ready() const noexcept { return false; }
+
+        bool await_suspend(std::coroutine_handle<> h) noexcept {
+            SetHandle(h);
+            return mGate.fetch_sub(1, std::memory_order_acq_rel) != 1;
+        }
+
+        size_t await_resume() const noexcept { return mWinner.load(std::memory_order_acquire); }
+
+        Async &operator[](size_t index) noexcept { return mTasks[index]; }
+
+        void Release() noexcept {
+            if (mRefs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                auto alloc = temp_alloc<AnyState>{};
+                allocator_destruct(alloc, this);
+            }
+        }
+
+    private:
+        std::atomic_size_t mWinner{None};
+        // opened by the combinator suspending and by the first arrival
+        std::atomic_int mGate{2};
+        std::atomic_size_t mRefs{1};
+        temp::vector<Async> mTasks{};
+        temp::unique_ptr<Node[]> mNodes{nullptr, 0};
+
+        std::coroutine_handle<> Arrive(size_t index) noexcept {
+            auto expected = None;
+            if (!mWinner.compare_exchange_strong(expected, index, std::memory_order_acq_rel)) {
+                return std::noop_coroutine();
+            }
+            if (mGate.fetch_sub(1, std::memory_order_acq_rel) == 1) return Transfer();
+            return std::noop_coroutine();
+        }
+    };
+}
+
+// Awaits all the tasks in the range, which are already running. The combinator is resumed once, by the last task to
+// complete, and the results are collected in the order of the range. If any of the tasks failed, the first failure in
+// the order of the range is rethrown after all the tasks are complete
+template<class Range, class T = typename Coro::When::Internal::ValueOf<std::ranges::range_value_t<Range>>::Type>
+ValueAsync<typename Coro::When::Internal::AllOf<T>::Type> WhenAll(Range tasks) {
+    using namespace Coro::When::Internal;
+    size_t count = 0;
+    for ([[maybe_unused]] auto &task: tasks) ++count;
+    Countdown countdown{count};
+    auto nodes = temp::make_unique<AllNode[]>(count);
+    size_t index = 0;
+    for (auto &task: tasks) {
+        nodes[index].Counter = &countdown;
+        if (!task.Chain(&nodes[index++])) countdown.Skip();
+    }
+    co_await countdown;
+    if constexpr (std::is_void_v<T>) {
+        for (auto &task: tasks) std::move(task).Take();
+    }
+    else {
+        temp::vector<T> results{};
+        results.reserve(count);
+        for (auto &task: tasks) results.push_back(std::move(task).Take());
+        co_return results;
+    }
+}
+
+// Awaits the first of the tasks in the range to complete, and returns its index along with its value. The other tasks
+// keep running to their completion in the background. If a cancellation source is given, it is cancelled once the
+// winner is known, so that the losers that were started with its token could stop early
+template<class Range, class T = typename Coro::When::Internal::ValueOf<std::ranges::range_value_t<Range>>::Type>
+ValueAsync<typename Coro::When::Internal::AnyOf<T>::Type> WhenAny(Range tasks, CancellationSource *losers = nullptr) {
+    using State = Coro::When::Internal::AnyState<std::ranges::range_value_t<Range>>;
+    const auto state = State::Create(tasks);
+    const auto scope = ScopeGuard([state]() noexcept { state->Release(); });
+    if (!state->Size()) throw std::invalid_argument("WhenAny on an empty range");
+    state->Start();
+    const auto winner = co_await *state;
+    if (losers) losers->Cancel();
+    if constexpr (std::is_void_v<T>) {
+        std::move((*state)[winner]).Take();
+        co_return winner;
+    }
+    else co_return std::pair<size_t, T>(winner, std::move((*state)[winner]).Take());
+}
@@ -3,6 +3,7 @@
 #include <string_view>
 #include "System/PmrBase.h"
 #include "Coro/ValueAsync.h"
+#include "Types.h"
 #include "Status.h"
 
 namespace IO {
@@ -17,15 +18,19 @@ namespace IO {
             F_EXLOCK = 32ul
         };
 
-        virtual ValueAsync<IOResult> Read(uint64_t buffer, uint64_t size, uint64_t offset) = 0;
+        virtual ValueAsync<IOResult> Read(uint64_t buffer, uint64_t size, uint64_t offset, Control control = {}) = 0;
 
-        virtual ValueAsync<IOResult> Write(uint64_t buffer, uint64_t size, uint64_t offset) = 0;
+        virtual ValueAsync<IOResult> Write(uint64_t buffer, uint64_t size, uint64_t offset, Control control = {}) = 0;
 
-        virtual ValueAsync<Status> ReadA(uint64_t *buffers, uint64_t *sizes, uint64_t *offsets, uint64_t *spans) = 0;
+        virtual ValueAsync<Status> ReadA(
+                uint64_t *buffers, uint64_t *sizes, uint64_t *offsets, uint64_t *spans, Control control = {}
+        ) = 0;
 
-        virtual ValueAsync<Status> WriteA(uint64_t *buffers, uint64_t *sizes, uint64_t *offsets, uint64_t *spans) = 0;
+        virtual ValueAsync<Status> WriteA(
+                uint64_t *buffers, uint64_t *sizes, uint64_t *offsets, uint64_t *spans, Control control = {}
+        ) = 0;
 
-        virtual ValueAsync<Status> Sync() = 0;
+        virtual ValueAsync<Status> Sync(Control control = {}) = 0;
 
         virtual ValueAsync<Status> Close() = 0;
     };
@@ -0,0 +1,150 @@
+#include "Buffered.h"
+#include <bit>
+#include <cstring>
+#include <algorithm>
+
+using namespace IO;
+
+namespace {
+    Buffer Advance(const Buffer &buffer, uint32_t size) noexcept {
+        return {static_cast<std::byte *>(buffer.GetMem()) + size, buffer.GetSize() - size};
+    }
+}
+
+BufferedStream::BufferedStream(Stream &stream, uint32_t readCapacity, uint32_t writeCapacity):
+        mStream(stream), mMask(std::bit_ceil(std::max(readCapacity, 1u)) - 1),
+        mRead(std::make_unique<std::byte[]>(mMask + 1)),
+        mWriteCapacity(std::bit_ceil(std::max(writeCapacity, 1u))),
+        mWrite(std::make_unique<std::byte[]>(mWriteCapacity)) {}
+
+void BufferedStream::Peek(void *out, uint32_t size) const noexcept {
+    const auto head = mHead & mMask;
+    const auto first = std::min(size, mMask + 1 - head);
+    std::memcpy(out, mRead.get() + head, first);
+    std::memcpy(static_cast<std::byte *>(out) + first, mRead.get(), size - first);
+}
+
+ValueAsync<IOResult> BufferedStream::Refill(Control control) {
+    // restart from the front of the ring when it is empty, so that the free room is contiguous
+    if (mHead == mTail) mHead = mTail = 0;
+    const auto tail = mTail & mMask;
+    const auto free = mMask + 1 - (mTail - mHead);
+    const auto first = std::min(free, mMask + 1 - tail);
+    Buffer vec[2]{{mRead.get() + tail, first}, {mRead.get(), free - first}};
+    const auto result = free == first ?
+                        co_await mStream.Read(vec[0], std::move(control)) :
+                        co_await mStream.ReadV(vec, 2, std::move(control));
+    if (result.success()) mTail += result.result();
+    co_return result;
+}
+
+ValueAsync<IOResult> BufferedStream::Read(Buffer buffer, Control control) {
+    if (!GetBuffered()) {
+        if (buffer.GetSize() >= GetReadCapacity()) co_return co_await mStream.Read(buffer, std::move(control));
+        const auto result = co_await Refill(std::move(control));
+        if (!result.success() || result.result() == 0) co_return result;
+    }
+    const auto size = std::min(buffer.GetSize(), GetBuffered());
+    Peek(buffer.GetMem(), size);
+    Consume(size);
+    co_return IOResult(IO_OK, static_cast<int32_t>(size));
+}
+
+ValueAsync<Status> BufferedStream::ReadExact(Buffer buffer, Control control) {
+    for (;;) {
+        const auto size = std::min(buffer.GetSize(), GetBuffered());
+        Peek(buffer.GetMem(), size);
+        Consume(size);
+        buffer = Advance(buffer, size);
+        if (!buffer.GetSize()) co_return IO_OK;
+        // the remainder not smaller than the ring is read directly into the buffer
+        const auto direct = buffer.GetSize() >= GetReadCapacity();
+        const auto result = direct ? co_await mStream.Read(buffer, control) : co_await Refill(control);
+        if (!result.success()) co_return result.error();
+        if (result.result() == 0) co_return IO_EOF;
+        if (direct) buffer = Advance(buffer, result.result());
+    }
+}
+
+ValueAsync<Status> BufferedStream::Fill(uint32_t size, Control control) {
+    while (GetBuffered() < size) {
+        const auto result = co_await Refill(control);
+        if (!result.success()) co_return result.error();
+        if (result.result() == 0) co_return IO_EOF;
+    }
+    co_return IO_OK;
+}
+
+ValueAsync<Status> BufferedStream::Skip(uint64_t size, Control control) {
+    for (;;) {
+        const auto step = static_cast<uint32_t>(std::min<uint64_t>(size, GetBuffered()));
+        Consume(step);
+        if (!(size -= step)) co_return IO_OK;
+        const auto result = co_await Refill(control);
+        if (!result.success()) co_return result.error();
+        if (result.result() == 0) co_return IO_EOF;
+    }
+}
+
+ValueAsync<Status> BufferedStream::Drain(Buffer *vec, int count, Control control) {
+    while (count) {
+        const auto result = count == 1 ?
+                            co_await mStream.Write(vec[0], control) : co_await mStream.WriteV(vec, count, control);
+        if (!result.success()) co_return result.error();
+        // skip over what has been sent, a short write resumes from the middle of a segment
+        auto sent = static_cast<uint32_t>(result.result());
+        const auto remaining = count;
+        while (count && sent >= vec->GetSize()) sent -= vec->GetSize(), ++vec, --count;
+        // nothing accepted while there is data left, the stream will not take any more
+        if (count == remaining && !result.result()) co_return IO_EOF;
+        if (count) *vec = Advance(*vec, sent);
+    }
+    co_return IO_OK;
+}
+
+ValueAsync<Status> BufferedStream::Write(Buffer buffer, Control control) {
+    if (buffer.GetSize() <= mWriteCapacity - mPending) {
+        std::memcpy(mWrite.get() + mPending, buffer.GetMem(), buffer.GetSize());
+        mPending += buffer.GetSize();
+        co_return IO_OK;
+    }
+    Buffer vec[2]{{mWrite.get(), mPending}, buffer};
+    const auto pending = std::exchange(mPending, 0);
+    co_return co_await Drain(pending ? vec : vec + 1, pending ? 2 : 1, std::move(control));
+}
+
+ValueAsync<Status> BufferedStream::Flush(Control control) {
+    if (!mPending) co_return IO_OK;
+    Buffer vec[1]{{mWrite.get(), std::exchange(mPending, 0)}};
+    co_return co_await Drain(vec, 1, std::move(control));
+}
+
+ValueAsync<IOResult> FrameCodec::NextSize(Control control) {
+    if (const auto status = co_await mStream.Fill(HeaderSize, std::move(control)); status != IO_OK)
+        co_return IOResult(status);
+    unsigned char header[HeaderSize];
+    mStream.Peek(header, HeaderSize);
+    const auto size = uint32_t(header[0]) << 24 | uint32_t(header[1]) << 16 | uint32_t(header[2]) << 8 | header[3];
+    if (size > mLimit || size > uint32_t(INT32_MAX)) co_return IOResult(IO_EPROTO);
+    co_return IOResult(IO_OK, static_cast<int32_t>(size));
+}
+
+ValueAsync<IOResult> FrameCodec::Read(Buffer buffer, Control control) {
+    const auto size = co_await NextSize(control);
+    if (!size.success()) co_return size;
+    if (static_cast<uint32_t>(size.result()) > buffer.GetSize()) co_return IOResult(IO_EMSGSIZE);
+    mStream.Consume(HeaderSize);
+    const auto status = co_await mStream.ReadExact({buffer.GetMem(), size.result()}, std::move(control));
+    co_return status == IO_OK ? size : IOResult(status);
+}
+
+ValueAsync<Status> FrameCodec::Write(Buffer payload, Control control) {
+    if (payload.GetSize() > mLimit) co_return IO_EMSGSIZE;
+    const auto size = payload.GetSize();
+    const unsigned char header[HeaderSize]{
+            static_cast<unsigned char>(size >> 24), static_cast<unsigned char>(size >> 16),
+            static_cast<unsigned char>(size >> 8), static_cast<unsigned char>(size)
+    };
+    if (const auto status = co_await mStream.Write({header, HeaderSize}, control); status != IO_OK) co_return status;
+    co_return co_await mStream.Write(payload, std::move(control));
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <memory>
+#include "Stream.h"
+
+namespace IO {
+    // Buffering layer on top of a stream. Reads are served from a read-ahead ring that is refilled with a single
+    // receive covering all of its free room, so that many small reads of a protocol cost one operation.
+    // Writes are gathered in a write buffer that is sent on Flush, or once it overflows, in which case the
+    // buffered bytes and the overflowing data go out together with a single WriteV.
+    // At most one read and one write may be in progress at a time, they may run concurrently with each other
+    class BufferedStream : public Object {
+    public:
+        static constexpr uint32_t DefaultCapacity = 1u << 16;
+
+        // the capacities are rounded up to powers of two
+        explicit BufferedStream(
+                Stream &stream, uint32_t readCapacity = DefaultCapacity, uint32_t writeCapacity = DefaultCapacity
+        );
+
+        [[nodiscard]] Stream &GetStream() const noexcept { return mStream; }
+
+        [[nodiscard]] uint32_t GetReadCapacity() const noexcept { return mMask + 1; }
+
+        // the number of bytes received and not yet consumed
+        [[nodiscard]] uint32_t GetBuffered() const noexcept { return mTail - mHead; }
+
+        // the number of bytes written and not yet flushed
+        [[nodiscard]] uint32_t GetPending() const noexcept { return mPending; }
+
+        // reads up to the size of the buffer, a result of 0 is the end of the stream.
+        // reads not smaller than the ring bypass it when nothing is buffered
+        ValueAsync<IOResult> Read(Buffer buffer, Control control = {});
+
+        // fills the whole buffer, fails with IO_EOF if the stream ends before that
+        ValueAsync<Status> ReadExact(Buffer buffer, Control control = {});
+
+        // makes sure that at least the given number of bytes, no more than the read capacity, are buffered.
+        // fails with IO_EOF if the stream ends before that
+        ValueAsync<Status> Fill(uint32_t size, Control control = {});
+
+        // discards the given number of bytes from the stream, buffered or not
+        ValueAsync<Status> Skip(uint64_t size, Control control = {});
+
+        // copies buffered bytes without consuming them, the size should not exceed GetBuffered()
+        void Peek(void *out, uint32_t size) const noexcept;
+
+        void Consume(uint32_t size) noexcept { mHead += size; }
+
+        // the data is only guaranteed to be sent after a Flush
+        ValueAsync<Status> Write(Buffer buffer, Control control = {});
+
+        ValueAsync<Status> Flush(Control control = {});
+
+    private:
+        Stream &mStream;
+        // the ring indices run freely and are masked on access
+        uint32_t mMask, mHead{0}, mTail{0};
+        std::unique_ptr<std::byte[]> mRead;
+        uint32_t mWriteCapacity, mPending{0};
+        std::unique_ptr<std::byte[]> mWrite;
+
+        ValueAsync<IOResult> Refill(Control control);
+
+        // sends all the segments, fails with IO_EOF if the stream stops accepting data before that
+        ValueAsync<Status> Drain(Buffer *vec, int count, Control control);
+    };
+
+    // Frames of a 32-bit big-endian length prefix followed by the payload
+    class FrameCodec : public Object {
+    public:
+        static constexpr uint32_t HeaderSize = 4;
+        static constexpr uint32_t DefaultLimit = 1u << 24;
+
+        // frames larger than the limit are treated as a protocol error
+        explicit FrameCodec(BufferedStream &stream, uint32_t limit = DefaultLimit) noexcept:
+                mStream(stream), mLimit(limit) {}
+
+        // the size of the next frame without consuming it. fails with IO_EPROTO if the frame exceeds the limit
+        ValueAsync<IOResult> NextSize(Control control = {});
+
+        // receives the next frame into the buffer, returns the size of the payload. fails with IO_EMSGSIZE
+        // if the frame does not fit in the buffer, in which case the frame stays in place for a retry
+        ValueAsync<IOResult> Read(Buffer buffer, Control control = {});
+
+        // queues a frame, the frame is only guaranteed to be sent after a Flush
+        ValueAsync<Status> Write(Buffer payload, Control control = {});
+
+        ValueAsync<Status> Flush(Control control = {}) { return mStream.Flush(std::move(control)); }
+
+    private:
+        BufferedStream &mStream;
+        uint32_t mLimit;
+    };
+}
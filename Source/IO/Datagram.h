@@ -0,0 +1,54 @@
+#pragma once
+
+#include "System/PmrBase.h"
+#include "Coro/ValueAsync.h"
+#include "Stream.h"
+#include "Types.h"
+#include "Status.h"
+
+namespace IO {
+    struct Endpoint {
+        Address Addr{};
+        int Port{0};
+    };
+
+    class Datagram : public PmrBase {
+    public:
+        struct Message {
+            // the payload to send, or the room to receive into
+            Buffer Data;
+            // the destination to send to, or the source received from
+            Endpoint Peer{};
+            // the segment size for a send to be split into by GSO, or the segment size of the coalesced
+            // datagrams received with GRO. zero if not segmented
+            uint16_t Segment{0};
+            // the number of bytes transferred or the error of this message
+            IOResult Result{IO_OK};
+        };
+
+        virtual ValueAsync<IOResult> SendTo(Buffer buffer, Endpoint peer, Control control = {}) = 0;
+
+        virtual ValueAsync<IOResult> RecvFrom(Buffer buffer, Endpoint &peer, Control control = {}) = 0;
+
+        // the batch variants submit every message in one go. each message receives its own result, and the call
+        // completes with the number of messages that have succeeded. a send batch completes when all of them have
+        virtual ValueAsync<int> SendBatch(Message *messages, int count, Control control = {}) = 0;
+
+        // takes what is ready like recvmmsg: the batch completes once the first datagram is received, the receives
+        // that have not completed by then are cancelled and report IO_ECANCELED
+        virtual ValueAsync<int> RecvBatch(Message *messages, int count, Control control = {}) = 0;
+
+        virtual ValueAsync<Status> Close() = 0;
+    };
+
+    struct DatagramOptions {
+        // the default GSO segment size applied to every send, zero to disable
+        uint16_t SendSegment{0};
+        // accept GRO coalesced datagrams on receive
+        bool ReceiveCoalesce{false};
+    };
+
+    // binds a UDP socket to the address and port. creation fails with IO_ENOPROTOOPT if GSO or GRO is
+    // requested but not supported by the kernel
+    std::unique_ptr<Datagram> CreateDatagram(Address address, int port, DatagramOptions options = {});
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "Conc/Executor.h"
+
+namespace IO {
+    // An executor of which each worker owns a ring of its own. An idle worker waits on its ring instead of a
+    // semaphore, so that it wakes up for either a completion or a task. The operations submitted from a worker
+    // complete on the same worker without being handed across threads.
+    // All the operations submitted from the workers should have completed before the executor is destroyed
+    std::shared_ptr<IExecutor> CreateIntegratedExecutor(int workers);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <string_view>
+#include "Coro/ValueAsync.h"
+#include "Types.h"
+#include "Status.h"
+
+namespace IO {
+    enum class FileType {
+        Regular, Directory, Symlink, Other
+    };
+
+    struct FileStat {
+        using Clock = std::chrono::system_clock;
+
+        FileType Type{FileType::Other};
+        uint64_t Size{0};
+        // the permission bits
+        uint32_t Permissions{0};
+        Clock::time_point Modified{};
+        Clock::time_point Accessed{};
+    };
+
+    struct DirectoryEntry {
+        std::string Name;
+        FileType Type{FileType::Other};
+    };
+
+    // the relative paths are resolved against the current working directory.
+    // symbolic links are followed by Stat
+    ValueAsync<Status> Stat(std::string_view path, FileStat &out, Control control = {});
+
+    ValueAsync<Status> Rename(std::string_view from, std::string_view to, Control control = {});
+
+    // removes a file, or an empty directory
+    ValueAsync<Status> Unlink(std::string_view path, bool directory = false, Control control = {});
+
+    ValueAsync<Status> MkDir(std::string_view path, uint32_t permissions = 0755, Control control = {});
+
+    // appends the entries of the directory to the output, "." and ".." excluded.
+    // the directory is opened and closed asynchronously, the entries are read in large batches
+    ValueAsync<Status> ListDirectory(std::string_view path, std::vector<DirectoryEntry> &out, Control control = {});
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <bit>
+#include <atomic>
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+
+namespace IO {
+    struct LatencySummary {
+        uint64_t Count{0};
+        // in nanoseconds, as the upper bounds of the buckets the quantiles fall in
+        uint64_t P50{0}, P99{0}, P999{0}, Max{0};
+    };
+
+    // Log-linear histogram of non-negative values with a relative error of 1/8. The values below 8 have a bucket
+    // each, the larger ones are bucketed by the position of their leading bit and the 3 bits following it.
+    // Recording is lock-free and wait-free, snapshots are taken without stopping the recorders
+    class LatencyHistogram {
+        static constexpr int SubBits = 3;
+        static constexpr uint64_t Sub = 1u << SubBits;
+        static constexpr int Buckets = (64 - SubBits + 1) * Sub;
+    public:
+        void Record(uint64_t value) noexcept {
+            mBuckets[Index(value)].fetch_add(1, std::memory_order_relaxed);
+            for (auto max = mMax.load(std::memory_order_relaxed); value > max;) {
+                if (mMax.compare_exchange_weak(max, value, std::memory_order_relaxed)) break;
+            }
+        }
+
+        [[nodiscard]] LatencySummary Summarize() const noexcept {
+            uint64_t counts[Buckets], total = 0;
+            for (auto i = 0; i < Buckets; ++i) total += (counts[i] = mBuckets[i].load(std::memory_order_relaxed));
+            LatencySummary result{.Count = total, .Max = mMax.load(std::memory_order_relaxed)};
+            if (!total) return result;
+            const uint64_t ranks[3]{(total * 500 + 999) / 1000, (total * 990 + 999) / 1000, (total * 999 + 999) / 1000};
+            uint64_t *outs[3]{&result.P50, &result.P99, &result.P999};
+            uint64_t seen = 0;
+            for (auto i = 0, q = 0; i < Buckets && q < 3; ++i) {
+                seen += counts[i];
+                while (q < 3 && seen >= std::max<uint64_t>(ranks[q], 1)) *outs[q++] = std::min(UpperBound(i), result.Max);
+            }
+            return result;
+        }
+
+        void Reset() noexcept {
+            for (auto &bucket: mBuckets) bucket.store(0, std::memory_order_relaxed);
+            mMax.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<uint64_t> mBuckets[Buckets]{};
+        std::atomic<uint64_t> mMax{0};
+
+        static int Index(uint64_t value) noexcept {
+            if (value < Sub) return static_cast<int>(value);
+            const auto shift = std::bit_width(value) - (SubBits + 1);
+            return static_cast<int>((shift + 1) * Sub + ((value >> shift) - Sub));
+        }
+
+        static uint64_t UpperBound(int index) noexcept {
+            if (index < int(Sub)) return index;
+            const auto shift = index / Sub - 1, mantissa = index % Sub;
+            return ((Sub + mantissa + 1) << shift) - 1;
+        }
+    };
+
+    struct OperationStats {
+        const char *Name;
+        // the bytes transferred by the successful operations that move data
+        uint64_t Bytes;
+        // from the submission to the completion reaped from the ring
+        LatencySummary Service;
+        // from the completion to the awaiting coroutine being resumed
+        LatencySummary Scheduling;
+    };
+
+    // the instrumentation is off by default. when enabled, every operation is timestamped on submission,
+    // on completion and on resumption
+    void EnableInstrumentation(bool enable) noexcept;
+
+    // the statistics of the kinds of operation that have been recorded since the last reset
+    std::vector<OperationStats> SnapshotInstrumentation();
+
+    void ResetInstrumentation() noexcept;
+}
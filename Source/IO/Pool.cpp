@@ -0,0 +1,131 @@
+#include "Pool.h"
+#include <algorithm>
+
+using namespace IO;
+
+namespace {
+    std::string MakeKey(const Address &address, int port) {
+        std::string key{};
+        key.reserve(3 + address.GetSize());
+        key.push_back(static_cast<char>(address.GetFamily()));
+        key.push_back(static_cast<char>(port >> 8));
+        key.push_back(static_cast<char>(port));
+        key.append(reinterpret_cast<const char *>(address.GetData()), address.GetSize());
+        return key;
+    }
+
+    ValueAsync<void> CloseStream(std::unique_ptr<Stream> handle) { co_await handle->Close(); }
+}
+
+void ConnectionPool::CloseDetached(std::unique_ptr<Stream> handle) noexcept {
+    // the close finishes on its own, the coroutine keeps the stream alive until then
+    if (!handle) return;
+    CancellationScope detached{CancellationToken{}};
+    CloseStream(std::move(handle));
+}
+
+ConnectionPool::~ConnectionPool() noexcept {
+    for (auto &[key, peer]: mPeers) {
+        for (auto &idle: peer.Idles) CloseDetached(std::move(idle.Handle));
+    }
+}
+
+bool ConnectionPool::IsUsable(Idle &idle, Clock::time_point now) const noexcept {
+    return now - idle.Since < mOptions.IdleTimeout && idle.Handle->Probe() == IO_OK;
+}
+
+bool ConnectionPool::Waiter::await_suspend(std::coroutine_handle<> h) {
+    SetHandle(h);
+    // take the most recently returned stream first, it is the least likely to have gone stale. the candidate is
+    // probed outside the lock, meanwhile it stays counted to the peer as if it was checked out
+    const auto now = Clock::now();
+    std::unique_lock lk{mPool.mLock};
+    while (!mPeer.Idles.empty()) {
+        auto idle = std::move(mPeer.Idles.back());
+        mPeer.Idles.pop_back();
+        lk.unlock();
+        if (mPool.IsUsable(idle, now)) return (mHandle = std::move(idle.Handle), false);
+        Stale.push_back(std::move(idle.Handle));
+        lk.lock();
+        --mPeer.Total;
+    }
+    if (mPeer.Total < mPool.mOptions.MaxPerPeer) return (++mPeer.Total, false);
+    if (mPeer.Tail) mPeer.Tail->mNext = this; else mPeer.Head = this;
+    mPeer.Tail = this;
+    return true;
+}
+
+void ConnectionPool::Give(Peer &peer, std::unique_ptr<Stream> handle, Clock::time_point since) noexcept {
+    std::unique_lock lk{mLock};
+    if (const auto waiter = peer.Head; waiter) {
+        if (!(peer.Head = waiter->mNext)) peer.Tail = nullptr;
+        waiter->mHandle = std::move(handle);
+        lk.unlock();
+        waiter->Dispatch(); // this will invalidate the waiter
+        return;
+    }
+    if (handle && peer.Idles.size() < mOptions.MaxIdlePerPeer) {
+        // a stream given back by Prune keeps its age, the idles stay ordered by it
+        const auto pos = std::upper_bound(
+                peer.Idles.begin(), peer.Idles.end(), since,
+                [](Clock::time_point since, const Idle &idle) noexcept { return since < idle.Since; }
+        );
+        peer.Idles.insert(pos, {std::move(handle), since});
+        return;
+    }
+    --peer.Total;
+    lk.unlock();
+    CloseDetached(std::move(handle));
+}
+
+void ConnectionPool::Lease::Return() noexcept {
+    if (!mPool) return;
+    auto handle = std::move(mHandle);
+    if (mBroken) CloseDetached(std::move(handle));
+    // a broken stream still hands its slot over
+    std::exchange(mPool, nullptr)->Give(*mPeer, std::move(handle));
+}
+
+ValueAsync<ConnectionPool::Lease> ConnectionPool::Checkout(Address address, int port, Control control) {
+    Peer *peer;
+    {
+        const auto key = MakeKey(address, port);
+        std::lock_guard lk{mLock};
+        peer = &mPeers[key];
+    }
+    Waiter waiter{*this, *peer};
+    auto handle = co_await waiter;
+    for (auto &stale: waiter.Stale) CloseDetached(std::move(stale));
+    if (!handle) {
+        try {
+            handle = co_await Connect(address, port, std::move(control), mOptions.Socket);
+        }
+        catch (...) {
+            Give(*peer, nullptr);
+            throw;
+        }
+    }
+    co_return Lease(this, peer, std::move(handle));
+}
+
+void ConnectionPool::Prune() {
+    // all the idle streams are taken out to be probed outside the lock, the usable ones are given back afterwards
+    std::vector<std::pair<Peer *, Idle>> idles{};
+    {
+        std::lock_guard lk{mLock};
+        for (auto &[key, peer]: mPeers) {
+            for (auto &idle: peer.Idles) idles.emplace_back(&peer, std::move(idle));
+            peer.Idles.clear();
+        }
+    }
+    const auto now = Clock::now();
+    for (auto &[peer, idle]: idles) {
+        if (IsUsable(idle, now)) {
+            Give(*peer, std::move(idle.Handle), idle.Since);
+            continue;
+        }
+        // the slot of a stale stream is handed over like the one of a discarded lease
+        Give(*peer, nullptr);
+        CloseDetached(std::move(idle.Handle));
+    }
+}
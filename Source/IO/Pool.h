@@ -0,0 +1,141 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "Stream.h"
+#include "Coro/CoroDetail.h"
+#include "Conc/SpinLock.h"
+
+namespace IO {
+    struct PoolOptions {
+        // the number of streams to a peer, checked out, idle or connecting, that may exist at a time
+        uint32_t MaxPerPeer{16};
+        // the number of idle streams kept for a peer, the streams returned beyond this are closed
+        uint32_t MaxIdlePerPeer{8};
+        // idle streams older than this are closed instead of reused
+        std::chrono::steady_clock::duration IdleTimeout{std::chrono::seconds(60)};
+        // applied to the streams connected by the pool
+        SocketOptions Socket{};
+    };
+
+    // Reuses outbound streams keyed by the address and the port of the peer. An idle stream is health checked
+    // with Stream::Probe before it is handed out again. Once a peer has reached its cap, checkouts suspend
+    // and are served in order as streams are returned or discarded.
+    // The pool should outlive all the leases taken from it
+    class ConnectionPool : public Object {
+        using Clock = std::chrono::steady_clock;
+
+        struct Idle {
+            std::unique_ptr<Stream> Handle;
+            Clock::time_point Since;
+        };
+
+        class Waiter;
+
+        struct Peer {
+            // the streams that exist for this peer, including the ones being connected
+            uint32_t Total{0};
+            // ordered from the least to the most recently returned
+            std::vector<Idle> Idles{};
+            Waiter *Head{nullptr}, *Tail{nullptr};
+        };
+
+    public:
+        // a stream checked out from the pool, returned to it on destruction unless discarded
+        class Lease {
+        public:
+            Lease() noexcept = default;
+
+            Lease(Lease &&other) noexcept:
+                    mPool(std::exchange(other.mPool, nullptr)), mPeer(other.mPeer),
+                    mHandle(std::move(other.mHandle)), mBroken(other.mBroken) {}
+
+            Lease &operator=(Lease &&other) noexcept {
+                if (this != &other) {
+                    Return();
+                    mPool = std::exchange(other.mPool, nullptr);
+                    mPeer = other.mPeer;
+                    mHandle = std::move(other.mHandle);
+                    mBroken = other.mBroken;
+                }
+                return *this;
+            }
+
+            ~Lease() noexcept { Return(); }
+
+            Stream *operator->() const noexcept { return mHandle.get(); }
+
+            Stream &operator*() const noexcept { return *mHandle; }
+
+            explicit operator bool() const noexcept { return bool(mHandle); }
+
+            // the stream is closed on return instead of being reused, e.g. after an error or a protocol violation
+            void Discard() noexcept { mBroken = true; }
+
+            void Return() noexcept;
+
+        private:
+            friend class ConnectionPool;
+
+            ConnectionPool *mPool{nullptr};
+            Peer *mPeer{nullptr};
+            std::unique_ptr<Stream> mHandle{nullptr};
+            bool mBroken{false};
+
+            Lease(ConnectionPool *pool, Peer *peer, std::unique_ptr<Stream> handle) noexcept:
+                    mPool(pool), mPeer(peer), mHandle(std::move(handle)) {}
+        };
+
+        explicit ConnectionPool(PoolOptions options = {}) noexcept: mOptions(std::move(options)) {}
+
+        ConnectionPool(ConnectionPool &&) = delete;
+
+        ConnectionPool &operator=(ConnectionPool &&) = delete;
+
+        ~ConnectionPool() noexcept;
+
+        // hands out an idle stream to the peer or connects a new one. the control applies to the connect only
+        ValueAsync<Lease> Checkout(Address address, int port, Control control = {});
+
+        // closes the idle streams that have timed out or failed the health check. The streams are out of the pool
+        // while they are probed, a checkout meanwhile may connect a new stream or wait for one of them instead
+        void Prune();
+
+    private:
+        const PoolOptions mOptions;
+        Lock<SpinLock> mLock{};
+        // the peers are never erased so that the leases could refer to them
+        std::unordered_map<std::string, Peer> mPeers{};
+
+        class Waiter : public Coro::Internal::AwaitCore {
+        public:
+            Waiter(ConnectionPool &pool, Peer &peer) noexcept: mPool(pool), mPeer(peer) {}
+
+            [[nodiscard]] constexpr bool await_ready() const noexcept { return false; }
+
+            bool await_suspend(std::coroutine_handle<> h);
+
+            // a null stream is the permission to connect a new one
+            std::unique_ptr<Stream> await_resume() noexcept { return std::move(mHandle); }
+
+            std::vector<std::unique_ptr<Stream>> Stale{};
+        private:
+            friend class ConnectionPool;
+
+            ConnectionPool &mPool;
+            Peer &mPeer;
+            std::unique_ptr<Stream> mHandle{nullptr};
+            Waiter *mNext{nullptr};
+        };
+
+        // probes the stream, should not be called with the lock held
+        [[nodiscard]] bool IsUsable(Idle &idle, Clock::time_point now) const noexcept;
+
+        // hands the slot of a stream, with or without the stream, to the next waiter of the peer
+        void Give(Peer &peer, std::unique_ptr<Stream> handle, Clock::time_point since = Clock::now()) noexcept;
+
+        static void CloseDetached(std::unique_ptr<Stream> handle) noexcept;
+    };
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "Block.h"
+#include "Stream.h"
+
+namespace IO {
+    // sends a range of a block to a stream without copying it through the user space.
+    // fails with IO_EOF if the block ends before the range does, with IO_ENOTSUP for objects
+    // that are not provided by this library
+    ValueAsync<Status> Splice(Block &from, uint64_t offset, uint64_t size, Stream &to, Control control = {});
+}
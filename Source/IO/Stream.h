@@ -5,27 +5,39 @@
 #include "Types.h"
 #include "Status.h"
 #include <variant>
+#include <utility>
+#include <optional>
+#include <string_view>
 
 namespace IO {
     class Stream : public PmrBase {
     public:
-        virtual ValueAsync<IOResult> Read(Buffer buffer) = 0;
+        virtual ValueAsync<IOResult> Read(Buffer buffer, Control control = {}) = 0;
 
-        virtual ValueAsync<IOResult> Write(Buffer buffer) = 0;
+        virtual ValueAsync<IOResult> Write(Buffer buffer, Control control = {}) = 0;
 
-        virtual ValueAsync<IOResult> ReadV(Buffer *vec, int count) = 0;
+        virtual ValueAsync<IOResult> ReadV(Buffer *vec, int count, Control control = {}) = 0;
 
-        virtual ValueAsync<IOResult> WriteV(Buffer *vec, int count) = 0;
+        virtual ValueAsync<IOResult> WriteV(Buffer *vec, int count, Control control = {}) = 0;
 
         virtual ValueAsync<Status> Close() = 0;
+
+        // checks without blocking whether an idle stream is still usable. IO_OK if it is connected with
+        // nothing to read, IO_EOF if the peer has closed it, IO_EBUSY if unread data is pending,
+        // or the pending error of the connection
+        virtual Status Probe() noexcept = 0;
     };
 
     class Address {
     public:
+        // AF_Unix is not spelled as AF_UNIX to not collide with the macro from the system socket header
         enum Family {
-            AF_IPv4, AF_IPv6, AF_UNIX
+            AF_IPv4, AF_IPv6, AF_Unix
         };
 
+        // the capacity of a unix socket path, including the terminating or the leading null byte
+        static constexpr uint32_t UnixPathCapacity = 108;
+
         static Address CreateIPv4(std::byte *data) noexcept;
 
         static Address CreateIPv6(std::byte *data) noexcept;
@@ -34,16 +46,48 @@ namespace IO {
 
         static std::optional<Address> CreateIPv6(std::string_view text) noexcept;
 
+        // a path name of a unix socket. a name starting with a null byte is in the abstract namespace
+        static std::optional<Address> CreateUnix(std::string_view path) noexcept;
+
+        // a name in the abstract namespace of unix sockets, without the leading null byte
+        static std::optional<Address> CreateUnixAbstract(std::string_view name) noexcept;
+
         [[nodiscard]] auto GetFamily() const noexcept { return mFamily; }
 
         [[nodiscard]] auto GetData() const noexcept { return mStorage; }
 
+        [[nodiscard]] auto GetSize() const noexcept { return mSize; }
+
     private:
         Family mFamily;
-        std::byte mStorage[16];
+        uint32_t mSize;
+        std::byte mStorage[UnixPathCapacity];
+    };
+
+    // options applied to a socket before it is connected or starts listening. zero sized buffers and
+    // zero timeouts leave the system defaults. the tcp options are ignored for unix sockets
+    struct SocketOptions {
+        // SO_REUSEADDR, allows rebinding a listening address that still has connections in TIME_WAIT
+        bool ReuseAddress{false};
+        // SO_REUSEPORT, allows several acceptors to bind the same address with the kernel balancing
+        // the incoming connections among them, e.g. one acceptor per worker
+        bool ReusePort{false};
+        // TCP_NODELAY, disables the Nagle algorithm. the accepted streams inherit it from the acceptor
+        bool NoDelay{false};
+        // SO_SNDBUF and SO_RCVBUF in bytes
+        int SendBuffer{0};
+        int ReceiveBuffer{0};
+        // TCP_DEFER_ACCEPT in seconds, only wake the acceptor once the peer has sent data. acceptor only
+        int DeferAccept{0};
+        // TCP_FASTOPEN, the length of the pending fast open queue of an acceptor. for a connect, any
+        // non-zero value enables TCP_FASTOPEN_CONNECT so that the first write is carried by the SYN
+        int FastOpen{0};
     };
 
-    ValueAsync<std::unique_ptr<Stream>> Connect(Address address, int port);
+    // the port is ignored for unix sockets
+    ValueAsync<std::unique_ptr<Stream>> Connect(
+            Address address, int port, Control control = {}, SocketOptions options = {}
+    );
 
     class StreamAcceptor : public PmrBase {
     public:
@@ -53,10 +97,14 @@ namespace IO {
             std::unique_ptr<Stream> Handle{nullptr};
         };
 
-        virtual ValueAsync<Result> Once() = 0;
+        virtual ValueAsync<Result> Once(Control control = {}) = 0;
 
         virtual ValueAsync<Status> Close() = 0;
     };
 
-    std::unique_ptr<StreamAcceptor> CreateAcceptor(Address address, int port, int backlog);
+    // the port is ignored for unix sockets
+    std::unique_ptr<StreamAcceptor> CreateAcceptor(Address address, int port, int backlog, SocketOptions options = {});
+
+    // a pair of connected streams, the unix socket pair
+    std::pair<std::unique_ptr<Stream>, std::unique_ptr<Stream>> CreateStreamPair();
 }
\ No newline at end of file
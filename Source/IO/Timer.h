@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include "Coro/CoroDetail.h"
+
+namespace IO {
+    namespace Internal {
+        // intrusive node of the timer wheel, lives in the frame of the suspended coroutine
+        class TimerNode : public Coro::Internal::AwaitCore {
+        public:
+            using Clock = std::chrono::steady_clock;
+
+            explicit TimerNode(Clock::time_point due) noexcept: Due(due) {}
+
+            const Clock::time_point Due;
+            uint64_t Tick{0};
+            TimerNode *Next{nullptr};
+        };
+    }
+
+    class Delay : Internal::TimerNode {
+    public:
+        using TimerNode::Clock;
+
+        explicit Delay(Clock::time_point due) noexcept: TimerNode(due) {}
+
+        [[nodiscard]] bool await_ready() const noexcept { return Clock::now() >= Due; }
+
+        bool await_suspend(std::coroutine_handle<> h);
+
+        constexpr void await_resume() const noexcept {}
+    };
+
+    inline Delay SleepUntil(Delay::Clock::time_point due) noexcept { return Delay(due); }
+
+    template<class Rep, class Period>
+    Delay Sleep(const std::chrono::duration<Rep, Period> &span) noexcept {
+        return Delay(Delay::Clock::now() + std::chrono::duration_cast<Delay::Clock::duration>(span));
+    }
+}
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
+#include <cstddef>
 #include <type_traits>
+#include "Coro/Cancellation.h"
 
 namespace IO {
     class Buffer {
@@ -21,4 +24,38 @@ namespace IO {
         uintptr_t mMem;
         uint32_t mSize;
     };
+
+    // Per-operation control. An operation still pending at the deadline fails with IO_ETIMEDOUT,
+    // an operation still pending when the token is cancelled fails with IO_ECANCELED
+    struct Control {
+        using Clock = std::chrono::steady_clock;
+
+        Clock::time_point Deadline{Clock::time_point::max()};
+        CancellationToken Token{};
+        // by default the awaiting coroutine is resumed on the executor that was current when the operation
+        // was submitted. if set, it is resumed directly on the completion thread instead, which is only
+        // suitable for short continuations that neither block nor run user code
+        bool InlineCompletion{false};
+
+        [[nodiscard]] bool HasDeadline() const noexcept { return Deadline != Clock::time_point::max(); }
+
+        template<class Rep, class Period>
+        static Control After(const std::chrono::duration<Rep, Period> &timeout, CancellationToken token = {}) {
+            return Control{Clock::now() + std::chrono::duration_cast<Clock::duration>(timeout), std::move(token)};
+        }
+    };
+
+    struct ShutdownReport {
+        // the operations in flight when the shutdown started
+        size_t InFlight{0};
+        // the operations cancelled as they had not completed by the deadline
+        size_t Cancelled{0};
+        // the operations that have not completed even after being cancelled
+        size_t Leaked{0};
+    };
+
+    // shuts the shared ring down. the submissions fail with IO_ESHUTDOWN from now on, the operations in flight
+    // are waited for until the deadline and cancelled afterwards. the awaiting coroutines of the leaked
+    // operations are never resumed
+    ShutdownReport Shutdown(std::chrono::steady_clock::time_point deadline);
 }
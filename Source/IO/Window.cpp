@@ -0,0 +1,70 @@
+#include "Window.h"
+
+using namespace IO;
+
+void OutboundWindow::Admit(uint32_t size) noexcept {
+    mInFlight += size;
+    mPeak = std::max(mPeak, mInFlight);
+    if (mInFlight >= mHigh) mClosed = true;
+}
+
+bool OutboundWindow::TryAcquire(uint32_t size) noexcept {
+    std::lock_guard lk{mLock};
+    // the waiters go first even if the window is open
+    if (mClosed || mHead) return false;
+    Admit(size);
+    return true;
+}
+
+bool OutboundWindow::Enqueue(Internal::WindowWaiter *waiter) noexcept {
+    std::lock_guard lk{mLock};
+    // the window could have opened since the check in await_ready
+    if (!mClosed && !mHead) return (Admit(waiter->Size), false);
+    if (mTail) mTail->Next = waiter; else mHead = waiter;
+    mTail = waiter;
+    ++mWaiting;
+    mWaitingBytes += waiter->Size;
+    ++mSuspensions;
+    return true;
+}
+
+void OutboundWindow::Release(uint32_t size) {
+    Internal::WindowWaiter *admitted = nullptr, **last = &admitted;
+    {
+        std::lock_guard lk{mLock};
+        mInFlight -= size;
+        if (mClosed && mInFlight <= mLow) mClosed = false;
+        while (!mClosed && mHead) {
+            const auto waiter = mHead;
+            if (!(mHead = waiter->Next)) mTail = nullptr;
+            --mWaiting;
+            mWaitingBytes -= waiter->Size;
+            Admit(waiter->Size);
+            waiter->Next = nullptr;
+            *last = waiter;
+            last = &waiter->Next;
+        }
+    }
+    // resume outside the lock, a waiter resumed inline could re-enter the window
+    for (auto it = admitted; it;) {
+        const auto waiter = it;
+        it = it->Next;
+        waiter->Dispatch(); // this will invalidate the waiter
+    }
+}
+
+ValueAsync<IOResult> OutboundWindow::Write(Stream &stream, Buffer buffer, Control control) {
+    co_await Acquire(buffer.GetSize());
+    const auto result = co_await stream.Write(buffer, std::move(control));
+    Release(buffer.GetSize());
+    co_return result;
+}
+
+ValueAsync<IOResult> OutboundWindow::WriteV(Stream &stream, Buffer *vec, int count, Control control) {
+    uint32_t size = 0;
+    for (auto i = 0; i < count; ++i) size += vec[i].GetSize();
+    co_await Acquire(size);
+    const auto result = co_await stream.WriteV(vec, count, std::move(control));
+    Release(size);
+    co_return result;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <mutex>
+#include <algorithm>
+#include "Stream.h"
+#include "Coro/CoroDetail.h"
+#include "Conc/SpinLock.h"
+
+namespace IO {
+    class OutboundWindow;
+
+    namespace Internal {
+        // intrusive node of a suspended writer, lives in the frame of the suspended coroutine
+        class WindowWaiter : public Coro::Internal::AwaitCore {
+        public:
+            explicit WindowWaiter(OutboundWindow &window, uint32_t size) noexcept: Window(window), Size(size) {}
+
+            OutboundWindow &Window;
+            const uint32_t Size;
+            WindowWaiter *Next{nullptr};
+        };
+    }
+
+    // Bounds the number of bytes in flight on a stream. Once the bytes in flight reach the high watermark the
+    // window closes, writers that acquire room suspend and are resumed in order once the bytes in flight have
+    // drained to the low watermark. A single acquisition is always admitted into an open window even if it
+    // overshoots the high watermark, so that writes larger than the window do not stall forever
+    class OutboundWindow : public Object {
+    public:
+        struct Metrics {
+            // the bytes acquired and not yet released
+            uint64_t InFlight;
+            // the highest value of InFlight observed
+            uint64_t Peak;
+            // the number of writers currently suspended, and their total size in bytes
+            uint32_t Waiting;
+            uint64_t WaitingBytes;
+            // the number of acquisitions that had to suspend, in total
+            uint64_t Suspensions;
+        };
+
+        class [[nodiscard]] Acquisition : Internal::WindowWaiter {
+        public:
+            using WindowWaiter::WindowWaiter;
+
+            [[nodiscard]] bool await_ready() noexcept { return Window.TryAcquire(Size); }
+
+            bool await_suspend(std::coroutine_handle<> h) {
+                SetHandle(h);
+                return Window.Enqueue(this);
+            }
+
+            constexpr void await_resume() const noexcept {}
+        };
+
+        // the low watermark is clamped to the high one
+        OutboundWindow(uint64_t high, uint64_t low) noexcept: mHigh(high), mLow(std::min(low, high)) {}
+
+        // suspends until the window admits the given number of bytes
+        Acquisition Acquire(uint32_t size) noexcept { return Acquisition(*this, size); }
+
+        // returns the bytes of a completed write, the writers admitted by this are resumed on their executors
+        void Release(uint32_t size);
+
+        // acquires room for the data, writes it and releases the room once the write has completed.
+        // producers that do not await their writes should await Acquire() before issuing each of them instead
+        ValueAsync<IOResult> Write(Stream &stream, Buffer buffer, Control control = {});
+
+        ValueAsync<IOResult> WriteV(Stream &stream, Buffer *vec, int count, Control control = {});
+
+        [[nodiscard]] Metrics GetMetrics() const noexcept {
+            std::lock_guard lk{mLock};
+            return {mInFlight, mPeak, mWaiting, mWaitingBytes, mSuspensions};
+        }
+
+    private:
+        friend class Acquisition;
+
+        const uint64_t mHigh, mLow;
+        mutable Lock<SpinLock> mLock{};
+        bool mClosed{false};
+        uint64_t mInFlight{0}, mPeak{0}, mWaitingBytes{0}, mSuspensions{0};
+        uint32_t mWaiting{0};
+        Internal::WindowWaiter *mHead{nullptr}, *mTail{nullptr};
+
+        bool TryAcquire(uint32_t size) noexcept;
+
+        // returns false if the waiter is admitted without suspending
+        bool Enqueue(Internal::WindowWaiter *waiter) noexcept;
+
+        // should be called with the lock held
+        void Admit(uint32_t size) noexcept;
+    };
+}
@@ -1,6 +1,7 @@
 #include "IO/Block.h"
 #include "Uring.h"
 #include "Error.h"
+#include "Descriptor.h"
 #include "Temp/Deque.h"
 #include "System/FileSystem.h"
 #include <vector>
@@ -46,18 +47,20 @@ namespace {
         return result;
     }
 
-    class Impl final : public Block {
+    class Impl final : public Block, public Internal::Descriptor {
         template <Core::Ops Op>
-        ValueAsync<IOResult> Simple(uint64_t buffer, uint64_t size, uint64_t offset) {
+        ValueAsync<IOResult> Simple(uint64_t buffer, uint64_t size, uint64_t offset, Control control) {
             auto &core = Core::Get();
             core.Lock.Enter();
-            auto action = Core::Create<Op>(core, mFd, reinterpret_cast<void *>(buffer), size, offset);
+            auto action = Core::Create<Op>(core, control, mFd, reinterpret_cast<void *>(buffer), size, offset);
             core.Lock.Leave();
             co_return Internal::MapResult(co_await action);
         }
 
         template <Core::Ops Op>
-        auto PrepareComplex(uint64_t *buffers, uint64_t *sizes, uint64_t *offsets, uint64_t *spans) {
+        auto PrepareComplex(
+                uint64_t *buffers, uint64_t *sizes, uint64_t *offsets, uint64_t *spans, const Control &control
+        ) {
             auto &core = Core::Get();
             auto slices = SpliceComplex(buffers, sizes, offsets, spans);
             auto fin = std::make_unique<Core::Await[]>(slices.size());
@@ -66,7 +69,7 @@ namespace {
             auto total = uint64_t(0);
             for (auto &&[buffer, offset, size]: slices) {
                 total += size;
-                auto wrap = Core::Wrap<Op>(core, mFd, reinterpret_cast<void *>(buffer), size, offset);
+                auto wrap = Core::Wrap<Op>(core, control, mFd, reinterpret_cast<void *>(buffer), size, offset);
                 std::construct_at(iter++, wrap);
             }
             core.Lock.Leave();
@@ -74,8 +77,10 @@ namespace {
         }
 
         template <Core::Ops Op>
-        ValueAsync<Status> Complex(uint64_t *buffers, uint64_t *sizes, uint64_t *offsets, uint64_t *spans) {
-            auto&&[fin, count, total] = PrepareComplex<Op>(buffers, sizes, offsets, spans);
+        ValueAsync<Status> Complex(
+                uint64_t *buffers, uint64_t *sizes, uint64_t *offsets, uint64_t *spans, Control control
+        ) {
+            auto&&[fin, count, total] = PrepareComplex<Op>(buffers, sizes, offsets, spans, control);
             auto completed = uint64_t(0);
             auto aggregated = Status::IO_OK;
             for (auto i = 0; i < count; ++i) {
@@ -93,40 +98,44 @@ namespace {
     public:
         explicit Impl(int fd) noexcept: mFd{fd} {}
 
-        ValueAsync<IOResult> Read(uint64_t buffer, uint64_t size, uint64_t offset) override {
-            return Simple<Core::Read>(buffer, size, offset);
+        ValueAsync<IOResult> Read(uint64_t buffer, uint64_t size, uint64_t offset, Control control) override {
+            return Simple<Core::Read>(buffer, size, offset, std::move(control));
         }
 
-        ValueAsync<IOResult> Write(uint64_t buffer, uint64_t size, uint64_t offset) override {
-            return Simple<Core::Write>(buffer, size, offset);
+        ValueAsync<IOResult> Write(uint64_t buffer, uint64_t size, uint64_t offset, Control control) override {
+            return Simple<Core::Write>(buffer, size, offset, std::move(control));
         }
 
-        ValueAsync<Status> ReadA(uint64_t *buffers, uint64_t *sizes, uint64_t *offsets, uint64_t *spans) override {
-            return Complex<Core::Read>(buffers, sizes, offsets, spans);
+        ValueAsync<Status> ReadA(
+                uint64_t *buffers, uint64_t *sizes, uint64_t *offsets, uint64_t *spans, Control control
+        ) override {
+            return Complex<Core::Read>(buffers, sizes, offsets, spans, std::move(control));
         }
 
-        ValueAsync<Status> WriteA(uint64_t *buffers, uint64_t *sizes, uint64_t *offsets, uint64_t *spans) override {
-            return Complex<Core::Write>(buffers, sizes, offsets, spans);
+        ValueAsync<Status> WriteA(
+                uint64_t *buffers, uint64_t *sizes, uint64_t *offsets, uint64_t *spans, Control control
+        ) override {
+            return Complex<Core::Write>(buffers, sizes, offsets, spans, std::move(control));
         }
 
-        ValueAsync<Status> Sync() override {
+        ValueAsync<Status> Sync(Control control) override {
             auto &core = Core::Get();
             core.Lock.Enter();
-            auto action = Core::Create<Core::Sync>(core, mFd, IORING_FSYNC_DATASYNC);
+            auto action = Core::Create<Core::Sync>(core, control, mFd, IORING_FSYNC_DATASYNC);
             core.Lock.Leave();
-            co_return Internal::MapError(co_await action);
+            co_return Internal::MapResult(co_await action).error();
         }
 
         ValueAsync<Status> Close() override {
             auto &core = Core::Get();
             core.Lock.Enter();
-            auto sync = Core::Create<Core::Sync>(core, mFd, IORING_FSYNC_DATASYNC);
+            auto sync = Core::Create<Core::Sync>(core, {}, mFd, IORING_FSYNC_DATASYNC);
             core.Lock.Leave();
-            if (auto ret = Internal::MapError(co_await sync); ret == IO::IO_OK) {
+            if (auto ret = Internal::MapResult(co_await sync).error(); ret == IO::IO_OK) {
                 core.Lock.Enter();
-                auto action = Core::Create<Core::Close>(core, mFd);
+                auto action = Core::Create<Core::Close>(core, {}, mFd);
                 core.Lock.Leave();
-                co_return Internal::MapError(co_await action);
+                co_return Internal::MapResult(co_await action).error();
             } else co_return ret;
         }
 
@@ -134,7 +143,7 @@ namespace {
             auto &core = Core::Get();
             auto absolute = NEWorld::filesystem::absolute({path}).generic_string();
             core.Lock.Enter();
-            auto open = Core::Create<Core::Open>(core, 0, absolute.c_str(), FlagConv(flags), 00600);
+            auto open = Core::Create<Core::Open>(core, {}, 0, absolute.c_str(), FlagConv(flags), 00600);
             core.Lock.Leave();
             if (const auto r = Internal::MapResult(co_await open); r.success())
                 co_return r.result();
@@ -142,6 +151,8 @@ namespace {
                 throw exception_errc(r.error());
         }
 
+        [[nodiscard]] int GetDescriptor() const noexcept override { return mFd; }
+
     private:
         const int mFd;
     };
@@ -0,0 +1,182 @@
+#include "IO/Datagram.h"
+#include "Coro/Sync.h"
+#include "Coro/When.h"
+#include "Uring.h"
+#include "Error.h"
+#include "SockAddr.h"
+#include <netinet/udp.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+using namespace IO;
+using Internal::Core;
+
+namespace {
+    // the state of a message in-flight, the largest ancillary data carried is the GRO segment size
+    struct Slot {
+        msghdr Header{};
+        iovec Vec{};
+        sockaddr_storage Name{};
+        alignas(cmsghdr) char Ancillary[CMSG_SPACE(sizeof(int))]{};
+
+        void PrepareSend(const Buffer &data, const Endpoint &peer, uint16_t segment) noexcept {
+            Vec = {data.GetMem(), data.GetSize()};
+            Header.msg_name = &Name;
+            Header.msg_namelen = Internal::MakeSockAddr(peer.Addr, peer.Port, Name);
+            Header.msg_iov = &Vec;
+            Header.msg_iovlen = 1;
+            if (segment) {
+                Header.msg_control = Ancillary;
+                Header.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+                const auto cm = CMSG_FIRSTHDR(&Header);
+                cm->cmsg_level = SOL_UDP;
+                cm->cmsg_type = UDP_SEGMENT;
+                cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                std::memcpy(CMSG_DATA(cm), &segment, sizeof(uint16_t));
+            }
+        }
+
+        void PrepareRecv(const Buffer &data) noexcept {
+            Vec = {data.GetMem(), data.GetSize()};
+            Header.msg_name = &Name;
+            Header.msg_namelen = sizeof(Name);
+            Header.msg_iov = &Vec;
+            Header.msg_iovlen = 1;
+            Header.msg_control = Ancillary;
+            Header.msg_controllen = sizeof(Ancillary);
+        }
+
+        [[nodiscard]] Endpoint Peer() const noexcept {
+            Endpoint result{};
+            result.Addr = Internal::ParseSockAddr(Name, Header.msg_namelen, &result.Port);
+            return result;
+        }
+
+        [[nodiscard]] uint16_t Segment() noexcept {
+            for (auto cm = CMSG_FIRSTHDR(&Header); cm; cm = CMSG_NXTHDR(&Header, cm)) {
+                if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+                    int size{};
+                    std::memcpy(&size, CMSG_DATA(cm), sizeof(int));
+                    return static_cast<uint16_t>(size);
+                }
+            }
+            return 0;
+        }
+    };
+
+    class DatagramImpl final : public Datagram {
+        template<Core::Ops Op>
+        ValueAsync<int> Batch(Message *messages, int count, Control control) {
+            if (count <= 0) co_return 0;
+            auto slots = temp::make_unique<Slot[]>(count);
+            auto actions = temp::make_unique<Core::Await[]>(count);
+            for (auto i = 0; i < count; ++i) {
+                if constexpr (Op == Core::SendMsg)
+                    slots[i].PrepareSend(messages[i].Data, messages[i].Peer, messages[i].Segment);
+                else
+                    slots[i].PrepareRecv(messages[i].Data);
+            }
+            auto &core = Core::Get();
+            core.Lock.Enter();
+            for (auto i = 0; i < count; ++i) {
+                std::construct_at(&actions[i], Core::Prepare<Op>(core, control, mFd, &slots[i].Header, 0));
+            }
+            Core::Submit(core);
+            core.Lock.Leave();
+            if constexpr (Op == Core::RecvMsg) {
+                // takes what is ready: the batch completes with the first receive and the rest are cancelled
+                AsyncManualResetEvent first{};
+                temp::vector<ValueAsync<void>> receives{};
+                receives.reserve(count);
+                for (auto i = 0; i < count; ++i) receives.push_back(Receive(actions[i], messages[i], slots[i], first));
+                co_await first.Wait();
+                for (auto i = 0; i < count; ++i) actions[i].Cancel();
+                co_await WhenAll(std::move(receives));
+            }
+            else {
+                for (auto i = 0; i < count; ++i) messages[i].Result = Internal::MapResult(co_await actions[i]);
+            }
+            auto succeeded = 0;
+            for (auto i = 0; i < count; ++i) if (messages[i].Result.success()) ++succeeded;
+            co_return succeeded;
+        }
+
+        static ValueAsync<void> Receive(Core::Await &action, Message &message, Slot &slot, AsyncManualResetEvent &first) {
+            message.Result = Internal::MapResult(co_await action);
+            if (message.Result.success()) {
+                message.Peer = slot.Peer();
+                message.Segment = slot.Segment();
+            }
+            first.Set();
+        }
+
+    public:
+        explicit DatagramImpl(int socket) noexcept: mFd(socket) {}
+
+        ValueAsync<IOResult> SendTo(Buffer buffer, Endpoint peer, Control control) override {
+            Slot slot{};
+            slot.PrepareSend(buffer, peer, 0);
+            auto &core = Core::Get();
+            core.Lock.Enter();
+            auto action = Core::Create<Core::SendMsg>(core, control, mFd, &slot.Header, 0);
+            core.Lock.Leave();
+            co_return Internal::MapResult(co_await action);
+        }
+
+        ValueAsync<IOResult> RecvFrom(Buffer buffer, Endpoint &peer, Control control) override {
+            Slot slot{};
+            slot.PrepareRecv(buffer);
+            auto &core = Core::Get();
+            core.Lock.Enter();
+            auto action = Core::Create<Core::RecvMsg>(core, control, mFd, &slot.Header, 0);
+            core.Lock.Leave();
+            const auto result = Internal::MapResult(co_await action);
+            if (result.success()) peer = slot.Peer();
+            co_return result;
+        }
+
+        ValueAsync<int> SendBatch(Message *messages, int count, Control control) override {
+            return Batch<Core::SendMsg>(messages, count, std::move(control));
+        }
+
+        ValueAsync<int> RecvBatch(Message *messages, int count, Control control) override {
+            return Batch<Core::RecvMsg>(messages, count, std::move(control));
+        }
+
+        ValueAsync<Status> Close() override {
+            auto &core = Core::Get();
+            core.Lock.Enter();
+            auto action = Core::Create<Core::Close>(core, {}, mFd);
+            core.Lock.Leave();
+            co_return Internal::MapResult(co_await action).error();
+        }
+
+    private:
+        const int mFd;
+    };
+}
+
+std::unique_ptr<Datagram> IO::CreateDatagram(Address address, int port, DatagramOptions options) {
+    const auto sock = socket(Internal::NativeFamily(address.GetFamily()), SOCK_DGRAM, 0);
+    if (sock != -1) {
+        sockaddr_storage target{};
+        const auto length = Internal::MakeSockAddr(address, port, target);
+        if (options.SendSegment) {
+            const int size = options.SendSegment;
+            if (setsockopt(sock, SOL_UDP, UDP_SEGMENT, &size, sizeof(size)) == -1) goto error;
+        }
+        if (options.ReceiveCoalesce) {
+            const int enable = 1;
+            if (setsockopt(sock, SOL_UDP, UDP_GRO, &enable, sizeof(enable)) == -1) goto error;
+        }
+        if (bind(sock, reinterpret_cast<sockaddr *>(&target), length) != -1) return std::make_unique<DatagramImpl>(sock);
+        error:
+        close(sock);
+    }
+    throw exception_errc(Internal::MapError(errno));
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+namespace IO::Internal {
+    // implemented by the objects backed by a file descriptor, so that the operations involving several
+    // objects, like splicing, could reach the descriptors behind the public interfaces
+    class Descriptor {
+    public:
+        [[nodiscard]] virtual int GetDescriptor() const noexcept = 0;
+
+    protected:
+        ~Descriptor() noexcept = default;
+    };
+}
@@ -72,6 +72,6 @@ namespace IO::Internal {
     }
 
     constexpr IOResult MapResult(int32_t ret) noexcept {
-        if (ret >= 0) return IOResult(IO_OK, ret); else return IOResult(MapError(ret));
+        if (ret >= 0) return IOResult(IO_OK, ret); else return IOResult(MapError(-ret));
     }
 }
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "IO/Executor.h"
+#include "Uring.h"
+#include "Error.h"
+#include "Conc/Executors/Executor.hpp"
+#include "Conc/Executors/FifoQueue.h"
+#include <unistd.h>
+
+using IO::Internal::Core;
+
+namespace {
+    class IntegratedExecutor final : public IExecutor {
+        struct Worker {
+            explicit Worker(int wakeup): Wakeup(wakeup), Ring(wakeup) {}
+
+            ~Worker() noexcept { close(Wakeup); }
+
+            ::Internal::Executor::FifoQueue<Task, true> Queue{};
+            // set while the worker is, or is about to be, waiting on its ring
+            std::atomic_bool Sleeping{false};
+            const int Wakeup;
+            Core Ring;
+            std::thread Thread{};
+        };
+
+    public:
+        explicit IntegratedExecutor(int workers):
+                IExecutor(static_cast<FnEnqueue>(&IntegratedExecutor::EnqueueRawImpl)),
+                mCount(std::max(workers, 1)) {
+            mWorkers = std::make_unique<std::unique_ptr<Worker>[]>(mCount);
+            for (auto i = 0; i < mCount; ++i) {
+                const auto wakeup = eventfd(0, EFD_CLOEXEC);
+                if (wakeup == -1) throw IO::exception_errc(IO::Internal::MapError(errno));
+                mWorkers[i] = std::make_unique<Worker>(wakeup);
+            }
+            for (auto i = 0; i < mCount; ++i) {
+                mWorkers[i]->Thread = std::thread([this, &w = *mWorkers[i]]() noexcept { Run(w); });
+            }
+        }
+
+        ~IntegratedExecutor() {
+            // the tasks added before are still drained
+            mRunning = false;
+            for (auto i = 0; i < mCount; ++i) mWorkers[i]->Ring.Wake();
+            for (auto i = 0; i < mCount; ++i) mWorkers[i]->Thread.join();
+        }
+
+    private:
+        inline static thread_local IntegratedExecutor *tOwner{nullptr};
+        inline static thread_local Worker *tWorker{nullptr};
+        std::atomic_bool mRunning{true};
+        std::atomic_uint mNext{0};
+        const int mCount;
+        std::unique_ptr<std::unique_ptr<Worker>[]> mWorkers;
+
+        void EnqueueRawImpl(Object *o, TaskFn fn) {
+            // a worker keeps the tasks it produces, the completions of its own operations included
+            auto &w = tOwner == this ? *tWorker : *mWorkers[mNext.fetch_add(1, std::memory_order_relaxed) % mCount];
+            w.Queue.Add({o, fn});
+            if (w.Sleeping.exchange(false)) w.Ring.Wake();
+        }
+
+        void Run(Worker &w) noexcept {
+            SetCurrentExecutor(this);
+            tOwner = this;
+            tWorker = &w;
+            Core::BindLocal(&w.Ring);
+            for (;;) {
+                for (auto task = w.Queue.Get(); task.Item; task = w.Queue.Get()) (*task.Item.*task.Entry)();
+                w.Ring.Reap(false);
+                if (w.Queue.SnapshotNotEmpty()) continue;
+                if (!mRunning) break;
+                w.Sleeping.store(true);
+                // a task could have been added before the flag is visible to the producer
+                if (!w.Queue.SnapshotNotEmpty() && mRunning) w.Ring.Reap(true);
+                w.Sleeping.store(false);
+            }
+            Core::BindLocal(nullptr);
+            tWorker = nullptr;
+            tOwner = nullptr;
+            SetCurrentExecutor(nullptr);
+        }
+    };
+}
+
+std::shared_ptr<IExecutor> IO::CreateIntegratedExecutor(int workers) {
+    return std::make_shared<IntegratedExecutor>(workers);
+}
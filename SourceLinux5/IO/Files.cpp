@@ -0,0 +1,131 @@
+#include "IO/Files.h"
+#include "Uring.h"
+#include "Error.h"
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+using namespace IO;
+using Internal::Core;
+
+namespace {
+    FileType TypeOfMode(uint32_t mode) noexcept {
+        switch (mode & S_IFMT) {
+            case S_IFREG: return FileType::Regular;
+            case S_IFDIR: return FileType::Directory;
+            case S_IFLNK: return FileType::Symlink;
+            default: return FileType::Other;
+        }
+    }
+
+    FileType TypeOfEntry(unsigned char type) noexcept {
+        switch (type) {
+            case DT_REG: return FileType::Regular;
+            case DT_DIR: return FileType::Directory;
+            case DT_LNK: return FileType::Symlink;
+            default: return FileType::Other;
+        }
+    }
+
+    FileStat::Clock::time_point TimeOf(const statx_timestamp &ts) noexcept {
+        using namespace std::chrono;
+        return FileStat::Clock::time_point(duration_cast<FileStat::Clock::duration>(
+                seconds(ts.tv_sec) + nanoseconds(ts.tv_nsec)
+        ));
+    }
+
+    struct linux_dirent64 {
+        ino64_t d_ino;
+        off64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[];
+    };
+
+    // the size of a batch of directory entries read at once
+    constexpr size_t ListingBatch = 32768;
+}
+
+// the paths are copied into the frames so that they are null terminated and outlive the submission
+
+ValueAsync<Status> IO::Stat(std::string_view path, FileStat &out, Control control) {
+    const std::string target{path};
+    struct statx result{};
+    auto &core = Core::Get();
+    core.Lock.Enter();
+    auto action = Core::Create<Core::Statx>(
+            core, control, AT_FDCWD, target.c_str(), AT_STATX_SYNC_AS_STAT, STATX_BASIC_STATS, &result
+    );
+    core.Lock.Leave();
+    if (const auto status = Internal::MapResult(co_await action).error(); status != IO_OK) co_return status;
+    out.Type = TypeOfMode(result.stx_mode);
+    out.Size = result.stx_size;
+    out.Permissions = result.stx_mode & 07777;
+    out.Modified = TimeOf(result.stx_mtime);
+    out.Accessed = TimeOf(result.stx_atime);
+    co_return IO_OK;
+}
+
+ValueAsync<Status> IO::Rename(std::string_view from, std::string_view to, Control control) {
+    const std::string source{from}, target{to};
+    auto &core = Core::Get();
+    core.Lock.Enter();
+    auto action = Core::Create<Core::Rename>(core, control, AT_FDCWD, source.c_str(), AT_FDCWD, target.c_str(), 0);
+    core.Lock.Leave();
+    co_return Internal::MapResult(co_await action).error();
+}
+
+ValueAsync<Status> IO::Unlink(std::string_view path, bool directory, Control control) {
+    const std::string target{path};
+    auto &core = Core::Get();
+    core.Lock.Enter();
+    auto action = Core::Create<Core::Unlink>(core, control, AT_FDCWD, target.c_str(), directory ? AT_REMOVEDIR : 0);
+    core.Lock.Leave();
+    co_return Internal::MapResult(co_await action).error();
+}
+
+ValueAsync<Status> IO::MkDir(std::string_view path, uint32_t permissions, Control control) {
+    const std::string target{path};
+    auto &core = Core::Get();
+    core.Lock.Enter();
+    auto action = Core::Create<Core::MkDir>(core, control, AT_FDCWD, target.c_str(), permissions);
+    core.Lock.Leave();
+    co_return Internal::MapResult(co_await action).error();
+}
+
+ValueAsync<Status> IO::ListDirectory(std::string_view path, std::vector<DirectoryEntry> &out, Control control) {
+    const std::string target{path};
+    auto &core = Core::Get();
+    core.Lock.Enter();
+    auto open = Core::Create<Core::Open>(core, control, AT_FDCWD, target.c_str(), O_RDONLY | O_DIRECTORY, 0);
+    core.Lock.Leave();
+    const auto opened = Internal::MapResult(co_await open);
+    if (!opened.success()) co_return opened.error();
+    const auto fd = opened.result();
+    // there is no uring operation for getdents, the entries are read with a plain system call which is
+    // served from the dentry cache in the common case
+    auto batch = temp::make_unique<uint64_t[]>(ListingBatch / sizeof(uint64_t));
+    const auto buffer = reinterpret_cast<char *>(batch.get());
+    auto status = IO_OK;
+    for (;;) {
+        const auto read = syscall(SYS_getdents64, fd, buffer, ListingBatch);
+        if (read <= 0) {
+            if (read < 0) status = Internal::MapError(errno);
+            break;
+        }
+        for (long offset = 0; offset < read;) {
+            const auto entry = reinterpret_cast<linux_dirent64 *>(buffer + offset);
+            offset += entry->d_reclen;
+            const std::string_view name{entry->d_name};
+            if (name == "." || name == "..") continue;
+            out.push_back({std::string(name), TypeOfEntry(entry->d_type)});
+        }
+    }
+    core.Lock.Enter();
+    auto close = Core::Create<Core::Close>(core, {}, fd);
+    core.Lock.Leave();
+    const auto closed = Internal::MapResult(co_await close).error();
+    co_return status != IO_OK ? status : closed;
+}
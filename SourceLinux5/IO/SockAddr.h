@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstring>
+#include <cstddef>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include "IO/Stream.h"
+
+namespace IO::Internal {
+    constexpr int NativeFamily(Address::Family family) noexcept {
+        switch (family) {
+            case Address::AF_IPv4: return AF_INET;
+            case Address::AF_IPv6: return AF_INET6;
+            case Address::AF_Unix: return AF_UNIX;
+        }
+        return AF_UNSPEC;
+    }
+
+    // the length of a unix socket address covers the terminating null byte of a path name,
+    // but nothing after a name in the abstract namespace. the port is ignored for unix sockets
+    inline socklen_t MakeSockAddr(const Address &address, int port, sockaddr_storage &out) noexcept {
+        switch (address.GetFamily()) {
+            case Address::AF_IPv4: {
+                auto &in = reinterpret_cast<sockaddr_in &>(out);
+                in.sin_family = AF_INET;
+                in.sin_port = htons(port);
+                std::memcpy(&in.sin_addr, address.GetData(), 4);
+                return sizeof(sockaddr_in);
+            }
+            case Address::AF_IPv6: {
+                auto &in = reinterpret_cast<sockaddr_in6 &>(out);
+                in.sin6_family = AF_INET6;
+                in.sin6_port = htons(port);
+                std::memcpy(&in.sin6_addr, address.GetData(), 16);
+                return sizeof(sockaddr_in6);
+            }
+            case Address::AF_Unix: {
+                auto &un = reinterpret_cast<sockaddr_un &>(out);
+                un.sun_family = AF_UNIX;
+                std::memcpy(un.sun_path, address.GetData(), address.GetSize());
+                const auto abstract = address.GetSize() > 0 && un.sun_path[0] == 0;
+                return offsetof(sockaddr_un, sun_path) + address.GetSize() + (abstract ? 0 : 1);
+            }
+        }
+        return 0;
+    }
+
+    inline Address ParseSockAddr(const sockaddr_storage &in, socklen_t length, int *port = nullptr) noexcept {
+        switch (in.ss_family) {
+            case AF_INET: {
+                auto &v4 = reinterpret_cast<const sockaddr_in &>(in);
+                if (port) *port = ntohs(v4.sin_port);
+                return Address::CreateIPv4(reinterpret_cast<std::byte *>(const_cast<in_addr *>(&v4.sin_addr)));
+            }
+            case AF_INET6: {
+                auto &v6 = reinterpret_cast<const sockaddr_in6 &>(in);
+                if (port) *port = ntohs(v6.sin6_port);
+                return Address::CreateIPv6(reinterpret_cast<std::byte *>(const_cast<in6_addr *>(&v6.sin6_addr)));
+            }
+            default: {
+                // unnamed unix peers come with an empty path
+                auto &un = reinterpret_cast<const sockaddr_un &>(in);
+                const auto offset = offsetof(sockaddr_un, sun_path);
+                const auto size = length > offset ? length - offset : 0;
+                if (port) *port = 0;
+                if (size == 0) return Address::CreateUnix({}).value();
+                if (un.sun_path[0] == 0) return Address::CreateUnix({un.sun_path, size}).value();
+                return Address::CreateUnix({un.sun_path, strnlen(un.sun_path, size)}).value();
+            }
+        }
+    }
+}
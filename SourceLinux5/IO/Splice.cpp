@@ -0,0 +1,64 @@
+#include "IO/Splice.h"
+#include "Uring.h"
+#include "Error.h"
+#include "Descriptor.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace IO;
+using Internal::Core;
+
+namespace {
+    // the pipe is enlarged to move larger chunks per round, the size is capped by /proc/sys/fs/pipe-max-size
+    constexpr int PipeSize = 1 << 20;
+
+    ValueAsync<IOResult> SpliceOnce(int in, int64_t offset, int out, uint32_t size, const Control &control) {
+        auto &core = Core::Get();
+        core.Lock.Enter();
+        auto action = Core::Create<Core::Splice>(core, control, in, offset, out, -1, size, SPLICE_F_MOVE);
+        core.Lock.Leave();
+        co_return Internal::MapResult(co_await action);
+    }
+
+    // Moves the range from the file into a pipe and from the pipe into the socket. The two halves are not
+    // linked into one chain, as the link is already used by the deadline of each operation, and a short
+    // splice into the pipe would cancel the linked one anyway
+    ValueAsync<Status> SpliceThrough(int file, uint64_t offset, uint64_t size, int socket, Control control) {
+        int pipes[2];
+        if (pipe2(pipes, O_CLOEXEC) == -1) co_return Internal::MapError(errno);
+        fcntl(pipes[1], F_SETPIPE_SZ, PipeSize);
+        const auto capacity = fcntl(pipes[1], F_GETPIPE_SZ);
+        const auto chunk = static_cast<uint64_t>(capacity > 0 ? capacity : 65536);
+        auto status = IO_OK;
+        while (size && status == IO_OK) {
+            const auto filled = co_await SpliceOnce(
+                    file, static_cast<int64_t>(offset), pipes[1], static_cast<uint32_t>(std::min(size, chunk)), control
+            );
+            if (!filled.success()) status = filled.error();
+            else if (filled.result() == 0) status = IO_EOF;
+            else {
+                offset += filled.result();
+                size -= filled.result();
+                // drain the pipe completely before refilling it, the socket may take it in several rounds
+                for (auto left = static_cast<uint32_t>(filled.result()); left;) {
+                    const auto sent = co_await SpliceOnce(pipes[0], -1, socket, left, control);
+                    if (!sent.success()) {
+                        status = sent.error();
+                        break;
+                    }
+                    left -= sent.result();
+                }
+            }
+        }
+        close(pipes[0]);
+        close(pipes[1]);
+        co_return status;
+    }
+}
+
+ValueAsync<Status> IO::Splice(Block &from, uint64_t offset, uint64_t size, Stream &to, Control control) {
+    const auto file = dynamic_cast<Internal::Descriptor *>(&from);
+    const auto socket = dynamic_cast<Internal::Descriptor *>(&to);
+    if (!file || !socket) co_return IO_ENOTSUP;
+    co_return co_await SpliceThrough(file->GetDescriptor(), offset, size, socket->GetDescriptor(), std::move(control));
+}
@@ -1,38 +1,48 @@
 #include "IO/Stream.h"
 #include "Uring.h"
 #include "Error.h"
-#include <vector>
+#include "SockAddr.h"
+#include "Descriptor.h"
 #include <cstring>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
+
+#ifndef TCP_FASTOPEN_CONNECT
+#define TCP_FASTOPEN_CONNECT 30
+#endif
 
 using namespace IO;
 using Internal::Core;
 
 namespace {
-    class StreamImpl : public Stream {
+    class StreamImpl : public Stream, public Internal::Descriptor {
         template<Core::Ops Op>
-        ValueAsync<IOResult> Simple(Buffer buffer) {
+        ValueAsync<IOResult> Simple(Buffer buffer, Control control) {
             auto &core = Core::Get();
             core.Lock.Enter();
-            auto action = Core::Create<Op>(core, mFd, buffer.GetMem(), buffer.GetSize(), 0);
+            auto action = Core::Create<Op>(core, control, mFd, buffer.GetMem(), buffer.GetSize(), 0);
             core.Lock.Leave();
             co_return Internal::MapResult(co_await action);
         }
 
+        // vectors up to this count are mapped in the coroutine frame, longer ones in temporary memory
+        static constexpr int InlineVectors = 16;
+
         template<Core::Ops Op>
-        ValueAsync<IOResult> Aggregated(Buffer *vec, int count) {
+        ValueAsync<IOResult> Aggregated(Buffer *vec, int count, Control control) {
             auto &core = Core::Get();
-            std::vector<iovec> mapped{static_cast<size_t>(count)};
-            for (auto it = vec, end = vec + count; it < end; ++it) {
-                mapped.push_back({it->GetMem(), it->GetSize()});
-            }
+            iovec inlined[InlineVectors];
+            temp::unique_ptr<iovec[]> spilled{nullptr, 0};
+            auto mapped = inlined;
+            if (count > InlineVectors) mapped = (spilled = temp::make_unique<iovec[]>(count)).get();
+            for (auto i = 0; i < count; ++i) mapped[i] = {vec[i].GetMem(), vec[i].GetSize()};
             msghdr message{
                     .msg_name = nullptr, .msg_namelen = 0,
-                    .msg_iov = mapped.data(), .msg_iovlen = mapped.size(),
+                    .msg_iov = mapped, .msg_iovlen = static_cast<size_t>(count),
                     .msg_control = nullptr, .msg_controllen = 0, .msg_flags = 0
             };
             core.Lock.Enter();
-            auto action = Core::Create<Op>(core, mFd, &message, 0);
+            auto action = Core::Create<Op>(core, control, mFd, &message, 0);
             core.Lock.Leave();
             co_return Internal::MapResult(co_await action);
         }
@@ -40,30 +50,40 @@ namespace {
     public:
         explicit StreamImpl(int socket) noexcept: mFd(socket) {}
 
-        ValueAsync<IOResult> Read(Buffer buffer) override {
-            return Simple<Core::Recv>(buffer);
+        ValueAsync<IOResult> Read(Buffer buffer, Control control) override {
+            return Simple<Core::Recv>(buffer, std::move(control));
         }
 
-        ValueAsync<IOResult> Write(Buffer buffer) override {
-            return Simple<Core::Send>(buffer);
+        ValueAsync<IOResult> Write(Buffer buffer, Control control) override {
+            return Simple<Core::Send>(buffer, std::move(control));
         }
 
-        ValueAsync<IOResult> ReadV(Buffer *vec, int count) override {
-            return Aggregated<Core::RecvMsg>(vec, count);
+        ValueAsync<IOResult> ReadV(Buffer *vec, int count, Control control) override {
+            return Aggregated<Core::RecvMsg>(vec, count, std::move(control));
         }
 
-        ValueAsync<IOResult> WriteV(Buffer *vec, int count) override {
-            return Aggregated<Core::SendMsg>(vec, count);
+        ValueAsync<IOResult> WriteV(Buffer *vec, int count, Control control) override {
+            return Aggregated<Core::SendMsg>(vec, count, std::move(control));
         }
 
         ValueAsync<Status> Close() override {
             auto &core = Core::Get();
             core.Lock.Enter();
-            auto action = Core::Create<Core::Close>(core, mFd);
+            auto action = Core::Create<Core::Close>(core, {}, mFd);
             core.Lock.Leave();
-            co_return Internal::MapError(co_await action);
+            co_return Internal::MapResult(co_await action).error();
         }
 
+        Status Probe() noexcept override {
+            char byte;
+            const auto ret = recv(mFd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+            if (ret == 0) return IO_EOF;
+            if (ret > 0) return IO_EBUSY;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? IO_OK : Internal::MapError(errno);
+        }
+
+        [[nodiscard]] int GetDescriptor() const noexcept override { return mFd; }
+
     private:
         const int mFd;
     };
@@ -75,9 +95,9 @@ namespace {
         ValueAsync<Status> Close() override {
             auto &core = Core::Get();
             core.Lock.Enter();
-            auto action = Core::Create<Core::Close>(core, mFd);
+            auto action = Core::Create<Core::Close>(core, {}, mFd);
             core.Lock.Leave();
-            co_return Internal::MapError(co_await action);
+            co_return Internal::MapResult(co_await action).error();
         }
 
     protected:
@@ -88,12 +108,14 @@ namespace {
     public:
         using AcceptImpl::AcceptImpl;
 
-        ValueAsync<Result> Once() override {
+        ValueAsync<Result> Once(Control control) override {
             auto &core = Core::Get();
             sockaddr_in address{};
             socklen_t length = sizeof(address);
             core.Lock.Enter();
-            auto action = Core::Create<Core::Accept>(core, mFd, reinterpret_cast<sockaddr *>(&address), &length, 0);
+            auto action = Core::Create<Core::Accept>(
+                    core, control, mFd, reinterpret_cast<sockaddr *>(&address), &length, 0
+            );
             core.Lock.Leave();
             const auto result = Internal::MapResult(co_await action);
             if (!result.success()) co_return Result{.Stat = result.error()};
@@ -108,12 +130,14 @@ namespace {
     public:
         using AcceptImpl::AcceptImpl;
 
-        ValueAsync<Result> Once() override {
+        ValueAsync<Result> Once(Control control) override {
             auto &core = Core::Get();
             sockaddr_in6 address{};
             socklen_t length = sizeof(address);
             core.Lock.Enter();
-            auto action = Core::Create<Core::Accept>(core, mFd, reinterpret_cast<sockaddr *>(&address), &length, 0);
+            auto action = Core::Create<Core::Accept>(
+                    core, control, mFd, reinterpret_cast<sockaddr *>(&address), &length, 0
+            );
             core.Lock.Leave();
             const auto result = Internal::MapResult(co_await action);
             if (!result.success()) co_return Result{.Stat = result.error()};
@@ -123,11 +147,34 @@ namespace {
             };
         }
     };
+
+    class AcceptImplUnix : public AcceptImpl {
+    public:
+        using AcceptImpl::AcceptImpl;
+
+        ValueAsync<Result> Once(Control control) override {
+            auto &core = Core::Get();
+            sockaddr_storage address{};
+            socklen_t length = sizeof(address);
+            core.Lock.Enter();
+            auto action = Core::Create<Core::Accept>(
+                    core, control, mFd, reinterpret_cast<sockaddr *>(&address), &length, 0
+            );
+            core.Lock.Leave();
+            const auto result = Internal::MapResult(co_await action);
+            if (!result.success()) co_return Result{.Stat = result.error()};
+            co_return Result{
+                    .Peer = Internal::ParseSockAddr(address, length),
+                    .Handle = std::make_unique<StreamImpl>(result.result())
+            };
+        }
+    };
 }
 
 Address IO::Address::CreateIPv4(std::byte *data) noexcept {
     Address ret{};
     ret.mFamily = AF_IPv4;
+    ret.mSize = 4;
     std::memcpy(ret.mStorage, data, 4);
     return ret;
 }
@@ -135,10 +182,32 @@ Address IO::Address::CreateIPv4(std::byte *data) noexcept {
 Address IO::Address::CreateIPv6(std::byte *data) noexcept {
     Address ret{};
     ret.mFamily = AF_IPv6;
+    ret.mSize = 16;
     std::memcpy(ret.mStorage, data, 16);
     return ret;
 }
 
+std::optional<Address> Address::CreateUnix(std::string_view path) noexcept {
+    static_assert(sizeof(sockaddr_un::sun_path) == UnixPathCapacity);
+    const auto abstract = !path.empty() && path.front() == 0;
+    // a path name needs a room for the terminating null byte
+    if (path.size() > (abstract ? UnixPathCapacity : UnixPathCapacity - 1)) return std::nullopt;
+    Address ret{};
+    ret.mFamily = AF_Unix;
+    ret.mSize = static_cast<uint32_t>(path.size());
+    std::memcpy(ret.mStorage, path.data(), path.size());
+    return ret;
+}
+
+std::optional<Address> Address::CreateUnixAbstract(std::string_view name) noexcept {
+    if (name.size() > UnixPathCapacity - 1) return std::nullopt;
+    Address ret{};
+    ret.mFamily = AF_Unix;
+    ret.mSize = static_cast<uint32_t>(name.size() + 1);
+    std::memcpy(ret.mStorage + 1, name.data(), name.size());
+    return ret;
+}
+
 std::optional<Address> Address::CreateIPv4(std::string_view text) noexcept {
     if (in_addr p{}; inet_pton(AF_INET, text.data(), &p) == 1)
         return CreateIPv4(reinterpret_cast<std::byte *>(&p.s_addr));
@@ -152,55 +221,120 @@ std::optional<Address> Address::CreateIPv6(std::string_view text) noexcept {
 }
 
 namespace {
-    ValueAsync<std::unique_ptr<Stream>> ConnectV4(Address address, int port) {
+    bool SetOption(int sock, int level, int name, int value) noexcept {
+        return setsockopt(sock, level, name, &value, sizeof(value)) != -1;
+    }
+
+    // returns false with errno set on the first option that fails to apply
+    bool ApplyOptions(int sock, const SocketOptions &options, bool tcp, bool listen) noexcept {
+        if (options.ReuseAddress && !SetOption(sock, SOL_SOCKET, SO_REUSEADDR, 1)) return false;
+        if (options.ReusePort && !SetOption(sock, SOL_SOCKET, SO_REUSEPORT, 1)) return false;
+        if (options.SendBuffer && !SetOption(sock, SOL_SOCKET, SO_SNDBUF, options.SendBuffer)) return false;
+        if (options.ReceiveBuffer && !SetOption(sock, SOL_SOCKET, SO_RCVBUF, options.ReceiveBuffer)) return false;
+        if (!tcp) return true;
+        if (options.NoDelay && !SetOption(sock, IPPROTO_TCP, TCP_NODELAY, 1)) return false;
+        if (listen) {
+            if (options.DeferAccept && !SetOption(sock, IPPROTO_TCP, TCP_DEFER_ACCEPT, options.DeferAccept))
+                return false;
+            if (options.FastOpen && !SetOption(sock, IPPROTO_TCP, TCP_FASTOPEN, options.FastOpen)) return false;
+        }
+        else if (options.FastOpen && !SetOption(sock, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1)) return false;
+        return true;
+    }
+
+    ValueAsync<std::unique_ptr<Stream>> ConnectV4(Address address, int port, Control control, SocketOptions options) {
         const auto sock = socket(AF_INET, SOCK_STREAM, 0);
         if (sock != -1) {
-            sockaddr_in in{.sin_family = AF_INET, .sin_port = htons(port)};
+            if (!ApplyOptions(sock, options, true, false)) {
+                const auto error = errno;
+                close(sock);
+                throw exception_errc(Internal::MapError(error));
+            }
+            sockaddr_storage in{};
+            const auto length = Internal::MakeSockAddr(address, port, in);
             auto &core = Core::Get();
             core.Lock.Enter();
-            auto action = Core::Create<Core::Connect>(core, sock, reinterpret_cast<sockaddr *>(&in), sizeof(in));
+            auto action = Core::Create<Core::Connect>(
+                    core, control, sock, reinterpret_cast<sockaddr *>(&in), length
+            );
             core.Lock.Leave();
             const auto result = Internal::MapResult(co_await action);
             if (result.success()) co_return std::make_unique<StreamImpl>(sock);
             close(sock);
+            // report the failure of the operation itself, a timed out or cancelled connect included
+            throw exception_errc(result.error());
         }
         throw exception_errc(Internal::MapError(errno));
     }
 
-    ValueAsync<std::unique_ptr<Stream>> ConnectV6(Address address, int port) {
+    ValueAsync<std::unique_ptr<Stream>> ConnectV6(Address address, int port, Control control, SocketOptions options) {
         const auto sock = socket(AF_INET6, SOCK_STREAM, 0);
         if (sock != -1) {
-            sockaddr_in6 in{.sin6_family = AF_INET6, .sin6_port = htons(port)};
+            if (!ApplyOptions(sock, options, true, false)) {
+                const auto error = errno;
+                close(sock);
+                throw exception_errc(Internal::MapError(error));
+            }
+            sockaddr_storage in{};
+            const auto length = Internal::MakeSockAddr(address, port, in);
             auto &core = Core::Get();
             core.Lock.Enter();
-            auto action = Core::Create<Core::Connect>(core, sock, reinterpret_cast<sockaddr *>(&in), sizeof(in));
+            auto action = Core::Create<Core::Connect>(
+                    core, control, sock, reinterpret_cast<sockaddr *>(&in), length
+            );
             core.Lock.Leave();
             const auto result = Internal::MapResult(co_await action);
             if (result.success()) co_return std::make_unique<StreamImpl>(sock);
             close(sock);
+            throw exception_errc(result.error());
+        }
+        throw exception_errc(Internal::MapError(errno));
+    }
+
+    ValueAsync<std::unique_ptr<Stream>> ConnectUnix(Address address, Control control, SocketOptions options) {
+        const auto sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (sock != -1) {
+            if (!ApplyOptions(sock, options, false, false)) {
+                const auto error = errno;
+                close(sock);
+                throw exception_errc(Internal::MapError(error));
+            }
+            sockaddr_storage un{};
+            const auto length = Internal::MakeSockAddr(address, 0, un);
+            auto &core = Core::Get();
+            core.Lock.Enter();
+            auto action = Core::Create<Core::Connect>(core, control, sock, reinterpret_cast<sockaddr *>(&un), length);
+            core.Lock.Leave();
+            const auto result = Internal::MapResult(co_await action);
+            if (result.success()) co_return std::make_unique<StreamImpl>(sock);
             close(sock);
+            throw exception_errc(result.error());
         }
         throw exception_errc(Internal::MapError(errno));
     }
 }
 
-ValueAsync<std::unique_ptr<Stream>> IO::Connect(Address address, int port) {
+ValueAsync<std::unique_ptr<Stream>> IO::Connect(Address address, int port, Control control, SocketOptions options) {
     switch (address.GetFamily()) {
         case Address::AF_IPv4:
-            return ConnectV4(address, port);
+            return ConnectV4(address, port, std::move(control), options);
         case Address::AF_IPv6:
-            return ConnectV6(address, port);
+            return ConnectV6(address, port, std::move(control), options);
+        case Address::AF_Unix:
+            return ConnectUnix(address, std::move(control), options);
         default:
             throw std::runtime_error("Invalid Peer Family");
     }
 }
 
 namespace {
-    std::unique_ptr<StreamAcceptor> AcceptorV4(Address address, int port, int backlog) {
+    std::unique_ptr<StreamAcceptor> AcceptorV4(Address address, int port, int backlog, const SocketOptions &options) {
         const auto sock = socket(AF_INET, SOCK_STREAM, 0);
         if (sock != -1) {
-            sockaddr_in target{.sin_family = AF_INET, .sin_port = htons(port)};
-            if (bind(sock, reinterpret_cast<sockaddr *>(&target), sizeof(target)) == -1) goto error;
+            sockaddr_storage target{};
+            const auto length = Internal::MakeSockAddr(address, port, target);
+            if (!ApplyOptions(sock, options, true, true)) goto error;
+            if (bind(sock, reinterpret_cast<sockaddr *>(&target), length) == -1) goto error;
             if (listen(sock, backlog) != -1) return std::make_unique<AcceptImpl4>(sock);
             error:
             close(sock);
@@ -208,26 +342,50 @@ namespace {
         throw exception_errc(Internal::MapError(errno));
     }
 
-    std::unique_ptr<StreamAcceptor> AcceptorV6(Address address, int port, int backlog) {
+    std::unique_ptr<StreamAcceptor> AcceptorV6(Address address, int port, int backlog, const SocketOptions &options) {
         const auto sock = socket(AF_INET6, SOCK_STREAM, 0);
         if (sock != -1) {
-            sockaddr_in6 target{.sin6_family = AF_INET6, .sin6_port = htons(port)};
-            if (bind(sock, reinterpret_cast<sockaddr *>(&target), sizeof(target)) == -1) goto error;
+            sockaddr_storage target{};
+            const auto length = Internal::MakeSockAddr(address, port, target);
+            if (!ApplyOptions(sock, options, true, true)) goto error;
+            if (bind(sock, reinterpret_cast<sockaddr *>(&target), length) == -1) goto error;
             if (listen(sock, backlog) != -1) return std::make_unique<AcceptImpl6>(sock);
             error:
             close(sock);
         }
         throw exception_errc(Internal::MapError(errno));
     }
+
+    std::unique_ptr<StreamAcceptor> AcceptorUnix(Address address, int backlog, const SocketOptions &options) {
+        const auto sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (sock != -1) {
+            sockaddr_storage target{};
+            const auto length = Internal::MakeSockAddr(address, 0, target);
+            if (!ApplyOptions(sock, options, false, true)) goto error;
+            if (bind(sock, reinterpret_cast<sockaddr *>(&target), length) == -1) goto error;
+            if (listen(sock, backlog) != -1) return std::make_unique<AcceptImplUnix>(sock);
+            error:
+            close(sock);
+        }
+        throw exception_errc(Internal::MapError(errno));
+    }
 }
 
-std::unique_ptr<StreamAcceptor> IO::CreateAcceptor(Address address, int port, int backlog) {
+std::unique_ptr<StreamAcceptor> IO::CreateAcceptor(Address address, int port, int backlog, SocketOptions options) {
     switch (address.GetFamily()) {
         case Address::AF_IPv4:
-            return AcceptorV4(address, port, backlog);
+            return AcceptorV4(address, port, backlog, options);
         case Address::AF_IPv6:
-            return AcceptorV6(address, port, backlog);
+            return AcceptorV6(address, port, backlog, options);
+        case Address::AF_Unix:
+            return AcceptorUnix(address, backlog, options);
         default:
             throw std::runtime_error("Invalid Peer Family");
     }
+}
+
+std::pair<std::unique_ptr<Stream>, std::unique_ptr<Stream>> IO::CreateStreamPair() {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) throw exception_errc(Internal::MapError(errno));
+    return {std::make_unique<StreamImpl>(fds[0]), std::make_unique<StreamImpl>(fds[1])};
 }
\ No newline at end of file
@@ -0,0 +1,208 @@
+#include "IO/Timer.h"
+#include "Uring.h"
+#include "Coro/ValueAsync.h"
+#include <bit>
+#include <mutex>
+#include <limits>
+#include <optional>
+
+using namespace IO;
+using Internal::Core;
+using Internal::TimerNode;
+
+namespace {
+    // Hierarchical timer wheel with a resolution of 1 tick. Level L holds the nodes that are due within
+    // 64^(L+1) ticks, indexed by the bits [6L, 6L+6) of their due tick. A slot of level L is cascaded into
+    // the lower levels when the current tick crosses the boundary of its block. An occupancy mask is kept
+    // for each level so that the next tick with any work to do is found without walking empty slots.
+    class TimerWheel {
+        static constexpr int Bits = 6;
+        static constexpr int Levels = 4;
+        static constexpr uint64_t Slots = 1u << Bits;
+        static constexpr uint64_t Mask = Slots - 1;
+        static constexpr uint64_t Range = uint64_t(1) << (Bits * Levels);
+    public:
+        static constexpr uint64_t Never = std::numeric_limits<uint64_t>::max();
+
+        explicit TimerWheel(uint64_t now) noexcept: mNow(now) {}
+
+        [[nodiscard]] uint64_t Now() const noexcept { return mNow; }
+
+        // the node should be due after the current tick
+        void Insert(TimerNode *node) noexcept {
+            const auto delta = node->Tick - mNow;
+            // nodes out of range are parked at the far end of the top level and re-inserted on cascade
+            const auto tick = delta < Range ? node->Tick : mNow + Range - 1;
+            auto level = 0;
+            while (level < Levels - 1 && delta >= (uint64_t(1) << (Bits * (level + 1)))) ++level;
+            const auto slot = (tick >> (Bits * level)) & Mask;
+            node->Next = mSlots[level][slot];
+            mSlots[level][slot] = node;
+            mOccupied[level] |= uint64_t(1) << slot;
+        }
+
+        // the earliest tick at which a slot needs to be fired or cascaded
+        [[nodiscard]] uint64_t NextDue() const noexcept {
+            auto result = Never;
+            for (auto level = 0; level < Levels; ++level) {
+                if (!mOccupied[level]) continue;
+                const auto shift = Bits * level;
+                const auto current = (mNow >> shift) & Mask;
+                // rotate the mask so that bit 0 is the slot right after the current one
+                const auto rotated = std::rotr(mOccupied[level], static_cast<int>((current + 1) & Mask));
+                const auto step = uint64_t(std::countr_zero(rotated)) + 1;
+                result = std::min(result, ((mNow >> shift) + step) << shift);
+            }
+            return result;
+        }
+
+        // advance the wheel to the given tick, returns the chain of expired nodes
+        TimerNode *Advance(uint64_t to) noexcept {
+            TimerNode *expired = nullptr;
+            for (;;) {
+                // no slot is touched before the next due tick, jump directly over the gap
+                const auto next = NextDue();
+                if (next > to) {
+                    mNow = std::max(mNow, to);
+                    return expired;
+                }
+                mNow = next;
+                Cascade(1);
+                const auto slot = mNow & Mask;
+                for (auto it = std::exchange(mSlots[0][slot], nullptr); it;) {
+                    const auto node = it;
+                    it = it->Next;
+                    node->Next = expired;
+                    expired = node;
+                }
+                mOccupied[0] &= ~(uint64_t(1) << slot);
+            }
+        }
+
+    private:
+        uint64_t mNow;
+        uint64_t mOccupied[Levels]{};
+        TimerNode *mSlots[Levels][Slots]{};
+
+        void Cascade(int level) noexcept {
+            if (level == Levels) return;
+            const auto shift = Bits * level;
+            // only cascade at the boundary of the block covered by a slot of this level
+            if (mNow & ((uint64_t(1) << shift) - 1)) return;
+            const auto slot = (mNow >> shift) & Mask;
+            if (slot == 0) Cascade(level + 1);
+            if (!(mOccupied[level] & (uint64_t(1) << slot))) return;
+            mOccupied[level] &= ~(uint64_t(1) << slot);
+            for (auto it = std::exchange(mSlots[level][slot], nullptr); it;) {
+                const auto node = it;
+                it = it->Next;
+                Insert(node);
+            }
+        }
+    };
+
+    // Drives the wheel with a single IORING_OP_TIMEOUT armed at the next due tick. The driver coroutine
+    // runs only while there are pending timers, and is woken early when a timer due before the armed
+    // timeout is added.
+    class TimerService {
+        using Clock = TimerNode::Clock;
+        using Tick = std::chrono::milliseconds;
+    public:
+        static TimerService &Get() {
+            static TimerService ins{};
+            return ins;
+        }
+
+        // returns false if the node is already due and should continue in place
+        bool Add(TimerNode *node) {
+            const auto tick = static_cast<uint64_t>(std::chrono::ceil<Tick>(node->Due - mEpoch).count());
+            std::unique_lock lk{mLock};
+            if (tick <= Current()) return false;
+            node->Tick = tick;
+            mWheel.Insert(node);
+            if (!mDriving) {
+                mDriving = true;
+                lk.unlock();
+                // the driver serves every timer, it should not follow the token of the one that started it
+                CancellationScope detached{CancellationToken{}};
+                Drive();
+            }
+            else if (mArmed && tick < mArmedAt) {
+                std::exchange(mArmed, nullptr)->Cancel();
+            }
+            return true;
+        }
+
+    private:
+        const Clock::time_point mEpoch{Clock::now()};
+        Lock<SpinLock> mLock{};
+        TimerWheel mWheel{0};
+        bool mDriving{false};
+        Core::Await *mArmed{nullptr};
+        uint64_t mArmedAt{TimerWheel::Never};
+        __kernel_timespec mSpec{};
+
+        [[nodiscard]] uint64_t Current() const noexcept {
+            return static_cast<uint64_t>(std::chrono::floor<Tick>(Clock::now() - mEpoch).count());
+        }
+
+        static void Fire(TimerNode *it) {
+            while (it) {
+                const auto node = it;
+                it = it->Next;
+                // the driver completes inline on the reaper, a sleeper without an executor should not run there
+                if (node->CanExecInPlace(nullptr))
+                    Core::Fallback()->Enqueue([node]() noexcept { node->Dispatch(); });
+                else
+                    node->Dispatch(); // this will invalidate the node
+            }
+        }
+
+        ValueAsync<void> Drive() {
+            // the wheel is driven by the shared ring which outlives any worker ring
+            auto &core = Core::Global();
+            std::optional<Core::Await> arm{};
+            for (;;) {
+                std::unique_lock lk{mLock};
+                mArmed = nullptr;
+                const auto expired = mWheel.Advance(Current());
+                const auto next = mWheel.NextDue();
+                if (next == TimerWheel::Never) {
+                    mDriving = false;
+                    mArmedAt = TimerWheel::Never;
+                    lk.unlock();
+                    Fire(expired);
+                    co_return;
+                }
+                // absolute timeout on CLOCK_MONOTONIC, the same clock as the steady clock
+                const auto due = (mEpoch + Tick(next)).time_since_epoch();
+                const auto secs = std::chrono::duration_cast<std::chrono::seconds>(due);
+                mSpec.tv_sec = secs.count();
+                mSpec.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(due - secs).count();
+                arm.reset();
+                core.Lock.Enter();
+                // the driver only advances the wheel and dispatches the timers to their executors
+                auto &armed = arm.emplace(Core::Wrap<Core::Timeout>(
+                        core, {.InlineCompletion = true}, &mSpec, 0, IORING_TIMEOUT_ABS
+                ));
+                core.Lock.Leave();
+                mArmed = &armed;
+                mArmedAt = next;
+                lk.unlock();
+                Fire(expired);
+                if (co_await armed == -ESHUTDOWN) {
+                    // the ring has shut down, the timers still pending are never fired
+                    std::lock_guard stop{mLock};
+                    mArmed = nullptr;
+                    mDriving = false;
+                    co_return;
+                }
+            }
+        }
+    };
+}
+
+bool Delay::await_suspend(std::coroutine_handle<> h) {
+    SetHandle(h);
+    return TimerService::Get().Add(this);
+}
@@ -0,0 +1,33 @@
+#include "Uring.h"
+
+IO::ShutdownReport IO::Shutdown(std::chrono::steady_clock::time_point deadline) {
+    const auto report = Internal::Core::Global().Shutdown(deadline);
+    if (report.Leaked) warningstream << report.Leaked << " IO operations leaked on shutdown";
+    return report;
+}
+
+void IO::EnableInstrumentation(bool enable) noexcept { Internal::Core::Instrumented = enable; }
+
+std::vector<IO::OperationStats> IO::SnapshotInstrumentation() {
+    using Internal::Core;
+    std::vector<OperationStats> result{};
+    auto &ins = Core::Instruments();
+    for (auto i = 0; i < Core::OpCount; ++i) {
+        auto service = ins.Service[i].Summarize();
+        if (!service.Count) continue;
+        result.push_back({
+                .Name = Core::OpNames[i], .Bytes = ins.Bytes[i].load(std::memory_order_relaxed),
+                .Service = service, .Scheduling = ins.Scheduling[i].Summarize()
+        });
+    }
+    return result;
+}
+
+void IO::ResetInstrumentation() noexcept {
+    auto &ins = Internal::Core::Instruments();
+    for (auto i = 0; i < Internal::Core::OpCount; ++i) {
+        ins.Service[i].Reset();
+        ins.Scheduling[i].Reset();
+        ins.Bytes[i].store(0, std::memory_order_relaxed);
+    }
+}
@@ -1,25 +1,64 @@
 #pragma once
 
 #include <atomic>
+#include <thread>
 #include <coroutine>
 #include <liburing.h>
+#include <sys/eventfd.h>
 #include "Temp/Temp.h"
+#include "Conc/Executor.h"
 #include "Conc/SpinLock.h"
+#include "Common/Logger.h"
 #include "IO/Status.h"
+#include "IO/Types.h"
+#include "IO/Metrics.h"
 
 namespace IO::Internal {
     class Core {
         static constexpr int QUEUE_DEPTH = 8192;
+        static constexpr int WORKER_QUEUE_DEPTH = 1024;
+        static constexpr auto CANCEL_GRACE = std::chrono::milliseconds(100);
     public:
         enum Ops {
-            Open, Read, Write, Sync, Close, Send, Recv, SendMsg, RecvMsg, Accept, Connect
+            Open, Read, Write, Sync, Close, Send, Recv, SendMsg, RecvMsg, Accept, Connect, Timeout,
+            Statx, Rename, Unlink, MkDir, Splice
         };
 
-        struct Await {
-            constexpr Await() noexcept = default;
+        static constexpr int OpCount = Splice + 1;
+
+        static constexpr const char *OpNames[OpCount]{
+                "Open", "Read", "Write", "Sync", "Close", "Send", "Recv", "SendMsg", "RecvMsg", "Accept", "Connect",
+                "Timeout", "Statx", "Rename", "Unlink", "MkDir", "Splice"
+        };
+
+        struct Instrumentation {
+            LatencyHistogram Service[OpCount]{}, Scheduling[OpCount]{};
+            std::atomic<uint64_t> Bytes[OpCount]{};
+        };
+
+        inline static std::atomic_bool Instrumented{false};
+
+        static Instrumentation &Instruments() noexcept {
+            static Instrumentation ins{};
+            return ins;
+        }
+
+        static uint64_t Now() noexcept {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()
+            ).count();
+        }
+
+        // An operation with a deadline is submitted as a pair of linked SQEs: the operation itself and a
+        // link timeout. Both of them post a CQE, so the await is only released after both have been reaped.
+        // The CQE of the link timeout carries the address of the await with the lowest bit set.
+        // The awaiting coroutine is resumed on the executor captured at submission, so that the reaper is never
+        // held up by user code, unless the operation has asked for an inline completion.
+        struct Await : private CancellationToken::Callback {
+            Await() noexcept: CancellationToken::Callback(&OnCancel) {}
 
             template <class Fn> requires std::is_invocable_v<Fn, Await*>
-            explicit Await(Fn&& fn) noexcept { fn(this); }
+            explicit Await(Fn&& fn) noexcept: CancellationToken::Callback(&OnCancel) { fn(this); }
 
             Await(Await &&) = delete;
 
@@ -32,6 +71,9 @@ namespace IO::Internal {
             [[nodiscard]] constexpr bool await_ready() const noexcept { return false; }
 
             bool await_suspend(std::coroutine_handle<> h) {
+                // registered here instead of at submission as the cancellation may be invoked in place
+                // which will need to acquire the core lock
+                mToken.Register(this);
                 const auto address = h.address();
                 for (;;) {
                     auto val = mNext.load();
@@ -40,32 +82,162 @@ namespace IO::Internal {
                 }
             }
 
-            [[nodiscard]] int32_t await_resume() const noexcept { return mStatus; }
+            [[nodiscard]] int32_t await_resume() noexcept {
+                mToken.Deregister(this);
+                return mStatus;
+            }
 
-            void Release(int32_t status) {
-                mStatus = status;
-                if (auto ths = mNext.exchange(INVALID_PTR); ths) {
-                    std::coroutine_handle<>::from_address(ths).resume();
-                }
+            // requests the kernel to cancel the submitted operation, which completes with ECANCELED if it was
+            // still in-flight. should not be called with the core lock held
+            void Cancel() noexcept {
+                if (!mCore) return; // rejected without being submitted
+                auto &c = *mCore;
+                c.Lock.Enter();
+                const auto sqe = GetSqe(c);
+                io_uring_prep_cancel(sqe, this, 0);
+                io_uring_sqe_set_data(sqe, nullptr);
+                io_uring_submit(&c.mRing);
+                c.Lock.Leave();
+            }
+
+            // called by the reaper on every CQE that carries the address of this await
+            static void Complete(void *data, int32_t status) {
+                const auto bits = std::bit_cast<uintptr_t>(data);
+                const auto ths = std::bit_cast<Await *>(bits & ~uintptr_t(1));
+                if (bits & 1) ths->mExpired = (status == -ETIME); else ths->mStatus = status;
+                if (--ths->mPending == 0) ths->Release();
             }
 
         private:
+            friend class Core;
+
             inline static void *INVALID_PTR = std::bit_cast<void *>(~uintptr_t(0));
             int32_t mStatus{};
+            int32_t mPending{1};
+            bool mExpired{false};
+            bool mInline{false};
             std::atomic<void *> mNext{nullptr};
+            Core *mCore{nullptr};
+            IExecutor *mExec{nullptr};
+            CancellationToken mToken{};
+            __kernel_timespec mDeadline{};
+            Await *mTrackPrev{nullptr}, *mTrackNext{nullptr};
+            Ops mOp{};
+            // the time of submission if the operation is instrumented, zero otherwise
+            uint64_t mSubmitted{0};
+
+            // completes the await in place with the given status, without anything submitted
+            void Reject(int32_t status) noexcept {
+                mStatus = status;
+                mPending = 0;
+                mNext.store(INVALID_PTR);
+            }
+
+            void Release() {
+                // a linked operation interrupted by its timeout completes with ECANCELED
+                if (mExpired && mStatus == -ECANCELED) mStatus = -ETIMEDOUT;
+                mCore->Untrack(this);
+                const auto completed = mSubmitted ? Record() : 0;
+                if (auto ths = mNext.exchange(INVALID_PTR); ths) {
+                    const auto h = std::coroutine_handle<>::from_address(ths);
+                    if (mInline) return h.resume();
+                    if (!completed) return (mExec ? mExec : Fallback())->Enqueue([h]() noexcept { h.resume(); });
+                    (mExec ? mExec : Fallback())->Enqueue([h, op = mOp, completed]() noexcept {
+                        Instruments().Scheduling[op].Record(Now() - completed);
+                        h.resume();
+                    });
+                }
+            }
+
+            // records the service latency and the bytes transferred, returns the time of completion
+            uint64_t Record() noexcept {
+                const auto now = Now();
+                auto &ins = Instruments();
+                ins.Service[mOp].Record(now - mSubmitted);
+                switch (mOp) {
+                    case Read: case Write: case Send: case Recv: case SendMsg: case RecvMsg: case Splice:
+                        if (mStatus > 0) ins.Bytes[mOp].fetch_add(mStatus, std::memory_order_relaxed);
+                    default: break;
+                }
+                return now;
+            }
+
+            void Link(io_uring_sqe *sqe, Core &c, const Control &control, Ops op) noexcept {
+                mOp = op;
+                mSubmitted = Instrumented.load(std::memory_order_relaxed) ? Now() : 0;
+                mCore = &c;
+                mExec = CurrentExecutor();
+                mInline = control.InlineCompletion;
+                // the operations without a token of their own follow the running coroutine, except for the closes
+                // that release the resources of the cancelled work
+                mToken = control.Token || op == Close ? control.Token : CancellationToken::Current();
+                c.Track(this);
+                io_uring_sqe_set_data(sqe, this);
+                if (control.HasDeadline()) {
+                    using namespace std::chrono;
+                    const auto span = control.Deadline.time_since_epoch();
+                    const auto secs = duration_cast<seconds>(span);
+                    mDeadline.tv_sec = secs.count();
+                    mDeadline.tv_nsec = duration_cast<nanoseconds>(span - secs).count();
+                    mPending = 2;
+                    sqe->flags |= IOSQE_IO_LINK;
+                    const auto timeout = GetSqe(c);
+                    io_uring_prep_link_timeout(timeout, &mDeadline, IORING_TIMEOUT_ABS);
+                    io_uring_sqe_set_data(timeout, std::bit_cast<void *>(std::bit_cast<uintptr_t>(this) | 1));
+                }
+            }
+
+            static void OnCancel(CancellationToken::Callback *cb) noexcept { static_cast<Await *>(cb)->Cancel(); }
         };
 
         Core() {
+            // the fallback is created first so that it is destroyed after the core, whose reaper may still
+            // release the operations left in flight onto it on exit
+            Fallback();
             io_uring_queue_init(QUEUE_DEPTH, &mRing, 0);
-            std::thread([this]() { while (WaitOneCqe()); }).detach();
+            mReaper = std::thread([this]() { while (WaitOneCqe()); });
         }
 
-        ~Core() { io_uring_queue_exit(&mRing); }
+        // a ring owned by an integrated worker, which reaps it on its own thread instead of a reaper.
+        // a read is kept armed on the eventfd so that a worker waiting for completions can be woken for tasks
+        explicit Core(int wakeup): mWakeup(wakeup) {
+            io_uring_queue_init(WORKER_QUEUE_DEPTH, &mRing, 0);
+            ArmWakeup();
+        }
+
+        ~Core() {
+            // nothing is cancelled on destruction, as resuming the awaits could reach the objects that have
+            // already been destroyed. the operations left are reported, an orderly exit should Shutdown() first
+            if (mReaper.joinable()) {
+                mClosing = true;
+                if (const auto left = InFlight(); left) warningstream << left << " IO operations left in flight on exit";
+                StopReaper();
+            }
+            io_uring_queue_exit(&mRing);
+        }
 
+        // Stops accepting submissions, which fail with IO_ESHUTDOWN from now on. The operations in flight are
+        // waited for until the deadline, and the ones remaining are cancelled. The reaper is joined afterwards.
+        // The operations that have not completed even after the cancellation are leaked, their awaiting
+        // coroutines are never resumed. Should not be called from a continuation that runs on the reaper
+        ShutdownReport Shutdown(std::chrono::steady_clock::time_point deadline) {
+            if (mClosing.exchange(true)) return {};
+            ShutdownReport report{.InFlight = InFlight()};
+            WaitDrained(deadline);
+            report.Cancelled = CancelAll();
+            WaitDrained(std::chrono::steady_clock::now() + CANCEL_GRACE);
+            report.Leaked = InFlight();
+            StopReaper();
+            return report;
+        }
+
+        // prepares the SQE(s) of an operation without submitting them, the caller should call Submit() afterwards.
+        // used to submit a batch of operations in one go
         template<Ops Op, class ...Args>
-        static auto Wrap(Core &c, Args &&... args) {
-            auto *sqe = GetSqe(c);
-            if constexpr(Op == Ops::Open) io_uring_prep_openat(sqe, std::forward<Args>(args)...);
+        static auto Prepare(Core &c, const Control &control, Args &&... args) {
+            auto *sqe = c.mClosing.load() ? nullptr : GetSqe(c, control.HasDeadline() ? 2 : 1);
+            if (!sqe) {}
+            else if constexpr(Op == Ops::Open) io_uring_prep_openat(sqe, std::forward<Args>(args)...);
             else if constexpr(Op == Ops::Read) io_uring_prep_read(sqe, std::forward<Args>(args)...);
             else if constexpr(Op == Ops::Write) io_uring_prep_write(sqe, std::forward<Args>(args)...);
             else if constexpr(Op == Ops::Sync) io_uring_prep_fsync(sqe, std::forward<Args>(args)...);
@@ -76,40 +248,167 @@ namespace IO::Internal {
             else if constexpr(Op == Ops::RecvMsg) io_uring_prep_recvmsg(sqe, std::forward<Args>(args)...);
             else if constexpr(Op == Ops::Accept) io_uring_prep_accept(sqe, std::forward<Args>(args)...);
             else if constexpr(Op == Ops::Connect) io_uring_prep_connect(sqe, std::forward<Args>(args)...);
-            return [&c, sqe](Await *ths) noexcept {
-                io_uring_sqe_set_data(sqe, ths);
-                io_uring_submit(&c.mRing);
+            else if constexpr(Op == Ops::Timeout) io_uring_prep_timeout(sqe, std::forward<Args>(args)...);
+            else if constexpr(Op == Ops::Statx) io_uring_prep_statx(sqe, std::forward<Args>(args)...);
+            else if constexpr(Op == Ops::Rename) io_uring_prep_renameat(sqe, std::forward<Args>(args)...);
+            else if constexpr(Op == Ops::Unlink) io_uring_prep_unlinkat(sqe, std::forward<Args>(args)...);
+            else if constexpr(Op == Ops::MkDir) io_uring_prep_mkdirat(sqe, std::forward<Args>(args)...);
+            else if constexpr(Op == Ops::Splice) io_uring_prep_splice(sqe, std::forward<Args>(args)...);
+            return [&c, &control, sqe](Await *ths) noexcept {
+                if (sqe) ths->Link(sqe, c, control, Op); else ths->Reject(-ESHUTDOWN);
             };
         }
 
         template<Ops Op, class ...Args>
-        static auto Create(Core &c, Args &&... args) { return Await{Wrap<Op>(c, std::forward<Args>(args)...)}; }
+        static auto Wrap(Core &c, const Control &control, Args &&... args) {
+            return [&c, prepare = Prepare<Op>(c, control, std::forward<Args>(args)...)](Await *ths) noexcept {
+                prepare(ths);
+                Submit(c);
+            };
+        }
+
+        static void Submit(Core &c) noexcept { io_uring_submit(&c.mRing); }
+
+        template<Ops Op, class ...Args>
+        static auto Create(Core &c, const Control &control, Args &&... args) {
+            return Await{Wrap<Op>(c, control, std::forward<Args>(args)...)};
+        }
 
-        static auto &Get() {
+        // the ring of the integrated worker running on the calling thread if any, the shared ring otherwise
+        static Core &Get() noexcept { return tLocal ? *tLocal : Global(); }
+
+        // the shared ring, reaped by its own thread
+        static Core &Global() {
             static Core ins{};
             return ins;
         }
 
+        static void BindLocal(Core *core) noexcept { tLocal = core; }
+
+        // reaps the completions of a worker ring. if none is ready and wait is set, blocks until there is one
+        // or until the worker is woken
+        void Reap(bool wait) {
+            io_uring_cqe *cqe{};
+            if ((wait ? io_uring_wait_cqe(&mRing, &cqe) : io_uring_peek_cqe(&mRing, &cqe)) != 0) return;
+            do Process(cqe); while (io_uring_peek_cqe(&mRing, &cqe) == 0);
+        }
+
+        void Wake() noexcept { eventfd_write(mWakeup, 1); }
+
+        // operations submitted from outside any executor are completed on a shared pool
+        static IExecutor *Fallback() {
+            static const auto ins = CreateScalingBagExecutor(
+                    1, static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u)), 1000
+            );
+            return ins.get();
+        }
+
         // We need the lock as we are not able to gather wait CQEs
         // Which made it not practical to use multiple rings to submit.
         // Since the ring itself is not constructed with thread safe ring,
         //     we need a large lock around the ring for safe submission
         SpinLock Lock{};
     private:
+        inline static thread_local Core *tLocal{nullptr};
         io_uring mRing{};
+        // the reaper thread of the shared ring, a NOP carrying its address asks it to stop
+        std::thread mReaper{};
+        std::atomic_bool mClosing{false};
+        // the awaits submitted and not yet released, for the shutdown to cancel them
+        ::Lock<SpinLock> mTrackLock{};
+        Await *mTracked{nullptr};
+        size_t mTrackedCount{0};
+        int mWakeup{-1};
+        eventfd_t mWakeValue{};
+
+        void ArmWakeup() {
+            Lock.Enter();
+            const auto sqe = GetSqe(*this);
+            io_uring_prep_read(sqe, mWakeup, &mWakeValue, sizeof(mWakeValue), 0);
+            io_uring_sqe_set_data(sqe, &mWakeValue);
+            io_uring_submit(&mRing);
+            Lock.Leave();
+        }
+
+        void Process(io_uring_cqe *cqe) {
+            const auto data = io_uring_cqe_get_data(cqe);
+            const auto status = cqe->res;
+            io_uring_cqe_seen(&mRing, cqe);
+            // CQEs of cancellation requests carry no data
+            if (data == &mWakeValue) ArmWakeup(); else if (data) Await::Complete(data, status);
+        }
 
         bool WaitOneCqe() {
             io_uring_cqe *cqe{};
             if (const auto ret = io_uring_wait_cqe(&mRing, &cqe); ret == 0) {
-                static_cast<Await *>(io_uring_cqe_get_data(cqe))->Release(cqe->res);
-                io_uring_cqe_seen(&mRing, cqe);
+                if (io_uring_cqe_get_data(cqe) == &mReaper) return (io_uring_cqe_seen(&mRing, cqe), false);
+                Process(cqe);
                 return true;
-            } else return (ret != ENXIO); // break if instance shutdown
+            } else return ret == -EINTR || ret == -EAGAIN; // break if the ring is no longer usable
+        }
+
+        // called with the core lock held
+        void Track(Await *await) noexcept {
+            std::lock_guard lk{mTrackLock};
+            await->mTrackPrev = nullptr;
+            await->mTrackNext = mTracked;
+            if (mTracked) mTracked->mTrackPrev = await;
+            mTracked = await;
+            ++mTrackedCount;
+        }
+
+        void Untrack(Await *await) noexcept {
+            std::lock_guard lk{mTrackLock};
+            if (await->mTrackPrev) await->mTrackPrev->mTrackNext = await->mTrackNext; else mTracked = await->mTrackNext;
+            if (await->mTrackNext) await->mTrackNext->mTrackPrev = await->mTrackPrev;
+            --mTrackedCount;
+        }
+
+        size_t InFlight() noexcept {
+            std::lock_guard lk{mTrackLock};
+            return mTrackedCount;
+        }
+
+        void WaitDrained(std::chrono::steady_clock::time_point deadline) {
+            while (InFlight() && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        size_t CancelAll() {
+            // the core lock is taken first as in Track(), no new await could be tracked afterwards
+            Lock.Enter();
+            size_t count = 0;
+            {
+                std::lock_guard lk{mTrackLock};
+                for (auto it = mTracked; it; it = it->mTrackNext, ++count) {
+                    const auto sqe = GetSqe(*this);
+                    io_uring_prep_cancel(sqe, it, 0);
+                    io_uring_sqe_set_data(sqe, nullptr);
+                }
+            }
+            io_uring_submit(&mRing);
+            Lock.Leave();
+            return count;
+        }
+
+        void StopReaper() {
+            if (!mReaper.joinable()) return;
+            Lock.Enter();
+            const auto sqe = GetSqe(*this);
+            io_uring_prep_nop(sqe);
+            io_uring_sqe_set_data(sqe, &mReaper);
+            io_uring_submit(&mRing);
+            Lock.Leave();
+            mReaper.join();
         }
 
-        static io_uring_sqe *GetSqe(Core &c) noexcept {
+        // reserves room for linked SQEs so that a link is never split across submissions.
+        // prepared but unsubmitted SQEs are flushed when the queue is full
+        static io_uring_sqe *GetSqe(Core &c, unsigned reserve = 1) noexcept {
             SpinWait spin{};
-            for (;;) if (const auto sqe = io_uring_get_sqe(&c.mRing); sqe) return sqe; else spin.SpinOnce();
+            while (io_uring_sq_space_left(&c.mRing) < reserve) if (io_uring_submit(&c.mRing) <= 0) spin.SpinOnce();
+            return io_uring_get_sqe(&c.mRing);
         }
     };
-}
\ No newline at end of file
+}
@@ -1,8 +1,14 @@
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstring>
 #include "Conc/Executor.h"
 #include "Coro/Coro.h"
 #include "Conc/BlockingAsContext.h"
 #include "IO/Block.h"
 #include "IO/Stream.h"
+#include "IO/Datagram.h"
+#include "IO/Buffered.h"
 
 std::atomic_int counter{0};
 
@@ -36,7 +42,9 @@ ValueAsync<void> FileIO() {
 }
 
 ValueAsync<void> ServerOnceEcho() {
-    auto accept = IO::CreateAcceptor(IO::Address::CreateIPv4("0.0.0.0").value(), 30080, 128);
+    auto accept = IO::CreateAcceptor(
+            IO::Address::CreateIPv4("0.0.0.0").value(), 30080, 128, {.ReuseAddress = true, .NoDelay = true}
+    );
     auto&&[stat, address, stream] = co_await accept->Once();
     char buffer[1000];
     auto resultA = co_await stream->Read({buffer, 1000});
@@ -59,11 +67,333 @@ ValueAsync<void> Network() {
     co_await Await(ServerOnceEcho(), ClientOnce());
 }
 
+ValueAsync<void> DatagramLoopback() {
+    const auto loopback = IO::Address::CreateIPv4("127.0.0.1").value();
+    auto server = IO::CreateDatagram(loopback, 30081);
+    auto client = IO::CreateDatagram(loopback, 30082);
+    const char *data[] = {"Hello", "World", "!"};
+    IO::Datagram::Message send[3] = {
+            {.Data = {data[0], 5}, .Peer = {loopback, 30081}},
+            {.Data = {data[1], 5}, .Peer = {loopback, 30081}},
+            {.Data = {data[2], 1}, .Peer = {loopback, 30081}}
+    };
+    co_await client->SendBatch(send, 3);
+    char buffer[3][100];
+    IO::Datagram::Message recv[3] = {{.Data = {buffer[0], 100}}, {.Data = {buffer[1], 100}}, {.Data = {buffer[2], 100}}};
+    const auto received = co_await server->RecvBatch(recv, 3);
+    for (int i = 0; i < 3; ++i) {
+        if (recv[i].Result.success())
+            printf("%d from port %d: %.*s\n", i, recv[i].Peer.Port, recv[i].Result.result(), buffer[i]);
+    }
+    printf("%d datagrams received\n", received);
+    co_await server->Close();
+    co_await client->Close();
+}
+
+ValueAsync<void> FramedPair() {
+    auto [left, right] = IO::CreateStreamPair();
+    IO::BufferedStream writer{*left}, reader{*right};
+    IO::FrameCodec out{writer}, in{reader};
+    const char *data[] = {"Hello", "World", "!"};
+    // three frames are queued and go out with a single write
+    for (auto x: data) co_await out.Write({x, strlen(x)});
+    co_await out.Flush();
+    char buffer[100];
+    for (int i = 0; i < 3; ++i) {
+        const auto result = co_await in.Read({buffer, 100});
+        if (result.success()) printf("frame %d: %.*s\n", i, result.result(), buffer);
+    }
+    co_await left->Close();
+    co_await right->Close();
+}
+
+ValueAsync<void> ReadAll(IO::Stream &stream, char *out, int64_t size) {
+    static char sink[1 << 16];
+    while (size > 0) {
+        const auto chunk = out ? size : std::min<int64_t>(size, sizeof(sink));
+        const auto result = co_await stream.Read({out ? out : sink, chunk});
+        if (!result.success() || result.result() == 0) break;
+        size -= result.result();
+        if (out) out += result.result();
+    }
+}
+
+// a vector write should send exactly its segments in order
+ValueAsync<void> WriteVRegression() {
+    auto [left, right] = IO::CreateStreamPair();
+    char data[40];
+    std::vector<IO::Buffer> vec{};
+    for (int i = 0; i < 40; ++i) data[i] = static_cast<char>('A' + i % 26);
+    for (int i = 0; i < 20; ++i) vec.emplace_back(data + 2 * i, 2);
+    // both below and above the inline capacity of the mapped vector
+    for (int count: {3, 20}) {
+        char buffer[40]{};
+        const auto written = co_await left->WriteV(vec.data(), count);
+        co_await ReadAll(*right, buffer, 2 * count);
+        const auto ok = written.result() == 2 * count && memcmp(buffer, data, 2 * count) == 0;
+        printf("WriteV with %d segments: %s\n", count, ok ? "ok" : "FAILED");
+    }
+    co_await left->Close();
+    co_await right->Close();
+}
+
+ValueAsync<void> WriteVBenchmark() {
+    using Clock = std::chrono::steady_clock;
+    constexpr int segment = 64, rounds = 20000;
+    static char data[64 * segment];
+    for (int count = 1; count <= 64; count *= 2) {
+        auto [left, right] = IO::CreateStreamPair();
+        std::vector<IO::Buffer> vec{};
+        for (int i = 0; i < count; ++i) vec.emplace_back(data + i * segment, segment);
+        const auto start = Clock::now();
+        auto reader = ReadAll(*right, nullptr, int64_t(rounds) * count * segment);
+        for (int i = 0; i < rounds; ++i) co_await left->WriteV(vec.data(), count);
+        co_await std::move(reader);
+        const auto seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        printf("WriteV %2d x %d bytes: %8.0f ops/s %8.2f MiB/s\n", count, segment,
+               rounds / seconds, rounds * double(count * segment) / seconds / (1 << 20));
+        co_await left->Close();
+        co_await right->Close();
+    }
+}
+
+// a BlockingAsContext stops for good after one Await, so the two run in sequence within one coroutine
+ValueAsync<void> WriteVSuite() {
+    co_await WriteVRegression();
+    co_await WriteVBenchmark();
+}
+
+ValueAsync<void> AmbientWaiter(AsyncManualResetEvent &resume, AsyncManualResetEvent &again) {
+    co_await resume.Wait();
+    // ready already, the coroutine does not suspend here
+    co_await AsyncManualResetEvent(true).Wait();
+    co_await again.Wait();
+}
+
+// the token of a coroutine should not stay ambient on the thread resuming it, after a ready await under a scope
+void AmbientRegression() {
+    CancellationSource source{};
+    AsyncManualResetEvent resume{}, again{};
+    ValueAsync<void> waiter{};
+    {
+        CancellationScope scope{source.Token()};
+        waiter = AmbientWaiter(resume, again);
+    }
+    source.Cancel();
+    // resumed in place on this thread, which has no token
+    resume.Set();
+    printf("ambient token after a ready await: %s\n", CancellationToken::IsCurrentCancelled() ? "FAILED" : "ok");
+    again.Set();
+}
+
+ValueAsync<void> SyncWorker(IExecutor *exec, AsyncMutex &mutex, AsyncSemaphore &semaphore, AsyncLatch &done,
+                            int &guarded, std::atomic_int &inside, std::atomic_int &peak) {
+    co_await SwitchTo(exec);
+    for (int i = 0; i < 1000; ++i) {
+        {
+            const auto guard = co_await mutex.ScopedLock();
+            ++guarded;
+        }
+        co_await semaphore.Acquire();
+        const auto now = inside.fetch_add(1) + 1;
+        for (auto seen = peak.load(); seen < now && !peak.compare_exchange_weak(seen, now);) {}
+        co_await Redispatch{};
+        inside.fetch_sub(1);
+        semaphore.Release();
+    }
+    done.CountDown();
+}
+
+// 200 coroutines on four workers: the mutex guards a plain counter, and the semaphore should never admit more
+// coroutines at once than it has units
+ValueAsync<void> SyncStress() {
+    constexpr int workers = 200, rounds = 1000, units = 3;
+    const auto exec = CreateScalingFIFOExecutor(4, 4, 1000);
+    AsyncMutex mutex{};
+    AsyncSemaphore semaphore{units};
+    AsyncLatch done{workers};
+    int guarded = 0;
+    std::atomic_int inside{0}, peak{0};
+    for (int i = 0; i < workers; ++i) SyncWorker(exec.get(), mutex, semaphore, done, guarded, inside, peak);
+    co_await done.Wait();
+    printf("mutex counter %d of %d: %s\n", guarded, workers * rounds, guarded == workers * rounds ? "ok" : "FAILED");
+    printf("semaphore peak %d of %d: %s\n", peak.load(), units, peak <= units ? "ok" : "FAILED");
+}
+
+ValueAsync<int> Double(IExecutor *exec, int value) {
+    co_await SwitchTo(exec);
+    co_return value * 2;
+}
+
+// the results of WhenAll come in the order of the range, and WhenAny hands over the value of its winner
+ValueAsync<void> Combinators() {
+    const auto exec = CreateScalingFIFOExecutor(4, 4, 1000);
+    std::vector<ValueAsync<int>> all{};
+    for (int i = 0; i < 100; ++i) all.push_back(Double(exec.get(), i));
+    const auto results = co_await WhenAll(std::move(all));
+    auto ordered = true;
+    for (int i = 0; i < 100; ++i) ordered = ordered && results[i] == i * 2;
+    printf("WhenAll of 100: %s\n", ordered ? "ok" : "FAILED");
+    std::vector<ValueAsync<int>> any{};
+    for (int i = 0; i < 10; ++i) any.push_back(Double(exec.get(), i));
+    const auto [index, value] = co_await WhenAny(std::move(any));
+    printf("WhenAny won by %zu: %s\n", index, value == static_cast<int>(index) * 2 ? "ok" : "FAILED");
+}
+
+LazyAsync<int> Deferred(bool &started) {
+    started = true;
+    co_return 42;
+}
+
+// a lazy task runs nothing until it is awaited or started
+ValueAsync<void> LazyTasks() {
+    const auto exec = CreateScalingFIFOExecutor(1, 1, 1000);
+    auto started = false;
+    auto task = Deferred(started);
+    printf("LazyAsync not run on creation: %s\n", started ? "FAILED" : "ok");
+    const auto awaited = co_await std::move(task);
+    printf("LazyAsync run when awaited: %s\n", started && awaited == 42 ? "ok" : "FAILED");
+    started = false;
+    const auto detached = co_await Deferred(started).Start(exec.get());
+    printf("LazyAsync run when started: %s\n", started && detached == 42 ? "ok" : "FAILED");
+}
+
+AsyncGenerator<int> Descending(IExecutor *exec, int from) {
+    for (int i = from; i > 0; --i) {
+        // the odd values are produced on the pool, the consumer is resumed on its own executor
+        if (i % 2) co_await SwitchTo(exec);
+        co_yield i;
+    }
+}
+
+ValueAsync<void> Generator() {
+    const auto exec = CreateScalingFIFOExecutor(1, 1, 1000);
+    auto generator = Descending(exec.get(), 100);
+    auto sum = 0, count = 0;
+    for (;;) {
+        const auto value = co_await generator.Next();
+        if (!value) break;
+        sum += *value;
+        ++count;
+    }
+    printf("AsyncGenerator pulled %d values: %s\n", count, count == 100 && sum == 5050 ? "ok" : "FAILED");
+}
+
+FlexAsync<int> SharedResult(IExecutor *exec) {
+    co_await SwitchTo(exec);
+    co_return 42;
+}
+
+ValueAsync<void> SharedWaiter(IExecutor *exec, FlexAsync<int> shared, AsyncLatch &done, std::atomic_int &hits) {
+    co_await SwitchTo(exec);
+    const auto value = co_await shared;
+    if (value == 42) hits.fetch_add(1);
+    done.CountDown();
+}
+
+// dozens of coroutines on four workers await each shared result, arriving both before and after it is set
+ValueAsync<void> FlexFanOut() {
+    constexpr int rounds = 1000, waiters = 32;
+    const auto exec = CreateScalingFIFOExecutor(4, 4, 1000);
+    AsyncLatch done{rounds * waiters};
+    std::atomic_int hits{0};
+    for (int r = 0; r < rounds; ++r) {
+        const auto shared = SharedResult(exec.get());
+        for (int i = 0; i < waiters; ++i) SharedWaiter(exec.get(), shared, done, hits);
+    }
+    co_await done.Wait();
+    printf("FlexAsync waiters resumed %d of %d: %s\n", hits.load(), rounds * waiters,
+           hits == rounds * waiters ? "ok" : "FAILED");
+}
+
+ValueAsync<int> Slow(IExecutor *exec) {
+    co_await SwitchTo(exec);
+    // completes well after the awaiter has suspended
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    co_return 1;
+}
+
+// each policy should leave the awaiting coroutine on the executor it promises
+ValueAsync<void> ResumePolicies() {
+    const auto pool = CreateScalingFIFOExecutor(2, 2, 1000), other = CreateScalingFIFOExecutor(1, 1, 1000);
+    const auto check = [](const char *policy, bool ok) { printf("Resume::%s: %s\n", policy, ok ? "ok" : "FAILED"); };
+    // the executors cannot be destroyed on their own workers, so the demo returns home before they are
+    const auto home = CurrentExecutor();
+    co_await SwitchTo(pool.get());
+    co_await Slow(other.get()).Configure(Resume::Inline{});
+    check("Inline", CurrentExecutor() == other.get());
+    co_await Slow(pool.get()).Configure(Resume::AnyWorker{other.get()});
+    check("AnyWorker", CurrentExecutor() == other.get());
+    co_await SwitchTo(pool.get());
+    co_await Slow(other.get()).Configure(Resume::SameThread{});
+    check("SameThread", CurrentExecutor() == pool.get());
+    co_await Slow(pool.get()).Configure(Resume::InlineAtMost{0, other.get()});
+    check("InlineAtMost forced", CurrentExecutor() == other.get());
+    // on a flat stack the row is broken by every suspension, so the limit is never reached
+    co_await SwitchTo(pool.get());
+    auto hops = 0;
+    for (int i = 0; i < 100; ++i) {
+        co_await Slow(pool.get()).Configure(Resume::InlineAtMost{2, other.get()});
+        if (CurrentExecutor() == other.get()) (++hops, co_await SwitchTo(pool.get()));
+    }
+    check("InlineAtMost flat", hops == 0);
+    co_await SwitchTo(home);
+}
+
 int main() {
     BlockingAsContext asCtx{};
     asCtx.Await(Network());
 }
 
+/*int main() {
+    AmbientRegression();
+}*/
+
+/*int main() {
+    BlockingAsContext asCtx{};
+    asCtx.Await(SyncStress());
+}*/
+
+/*int main() {
+    BlockingAsContext asCtx{};
+    asCtx.Await(Combinators());
+}*/
+
+/*int main() {
+    BlockingAsContext asCtx{};
+    asCtx.Await(LazyTasks());
+}*/
+
+/*int main() {
+    BlockingAsContext asCtx{};
+    asCtx.Await(Generator());
+}*/
+
+/*int main() {
+    BlockingAsContext asCtx{};
+    asCtx.Await(FlexFanOut());
+}*/
+
+/*int main() {
+    BlockingAsContext asCtx{};
+    asCtx.Await(ResumePolicies());
+}*/
+
+/*int main() {
+    BlockingAsContext asCtx{};
+    asCtx.Await(WriteVSuite());
+}*/
+
+/*int main() {
+    BlockingAsContext asCtx{};
+    asCtx.Await(FramedPair());
+}*/
+
+/*int main() {
+    BlockingAsContext asCtx{};
+    asCtx.Await(DatagramLoopback());
+}*/
+
 /*int main() {
     {
         auto exec = CreateScalingBagExecutor(1, 6, 1000);